@@ -23,6 +23,7 @@
 #include "MidiCC.h"
 #include "Constants.h"
 #include "Parameters.h"
+#include "HeapGuard.h"
 #include "PatchMgr.h"
 #include <USBHost_t36.h>
 #include "HWControls.h"
@@ -50,9 +51,12 @@
 #define SETTINGS 7       //Settings page
 #define SETTINGSVALUE 8  //Settings page
 #define CCPARAMS 9       //Params Page
+#define STATS 10         //Hidden timing stats page
 
 unsigned int state = PARAMETER;
 
+#include "SerialConsole.h"
+#include "Profiler.h"
 #include "SSD1306Display.h"
 
 boolean cardStatus = false;
@@ -75,8 +79,7 @@ struct VoiceAndNote voices[NO_OF_VOICES] = {
 };
 
 boolean voiceOn[NO_OF_VOICES] = { false, false, false, false, false, false, false, false };
-int voiceToReturn = -1;        //Initialise to 'null'
-long earliestTime = millis();  //For voice allocation - initialise to now
+uint8_t noteVoice[128] = { 0 };  // Voice + 1 playing each note in poly mode, 0 for none
 int prevNote = 0;              //Initialised to middle value
 bool notes[128] = { 0 }, initial_loop = 1;
 int8_t noteOrder[40] = { 0 }, orderIndx = { 0 };
@@ -97,6 +100,25 @@ int patchNo = 1;  //Current patch no
 // parameters: <number of shift registers> (data pin, clock pin, latch pin)
 ShiftRegister74HC595<4> sr(30, 31, 32);
 
+#include "VoiceChain.h"
+#include "GateScheduler.h"
+#include "Calibration.h"
+#include "Tuning.h"
+#include "ClockEngine.h"
+#include "ControlEngine.h"
+#include "Outputs.h"
+#include "Curves.h"
+#include "Euclid.h"
+#include "Triggers.h"
+#include "Sequencer.h"
+#include "Pedals.h"
+#include "Allocator.h"
+#include "ModMatrix.h"
+#include "HighResCC.h"
+#include "Quantizer.h"
+#include "MpeZone.h"
+#include "Generators.h"
+
 RoxButton paramButton;
 
 void setup() {
@@ -107,9 +129,27 @@ void setup() {
       ;  // Don't proceed, loop forever
   }
 
+  displaySlice = getDisplaySlice();
   setupDisplay();
   setUpSettings();
   setupHardware();
+  setupConsole();
+  setupProfiler();
+  setupGateScheduler();
+  setupCalibration();
+  setupClockEngine();
+  setupControlEngine();
+  setupOutputs();
+  setupCurves();
+  setupEuclid();
+  setupTriggers();
+  setupSequencer();
+  setupAllocator();
+  setupModMatrix();
+  setupHighResCC();
+  setupQuantizer();
+  setupMpeZone();
+  setupGenerators();
 
   paramButton.begin();
   paramButton.setDoublePressThreshold(300);
@@ -128,6 +168,7 @@ void setup() {
     Serial.println("SD card is not connected or unusable");
     showPatchPage("No SD", "conn'd / usable");
   }
+  setupTuning();
 
   //USB HOST MIDI Class Compliant
   delay(300);  //Wait to turn on USB Host
@@ -136,6 +177,7 @@ void setup() {
   midi1.setHandleNoteOff(myNoteOff);
   midi1.setHandleNoteOn(myNoteOn);
   midi1.setHandlePitchChange(myPitchBend);
+  midi1.setHandleAfterTouchPoly(myPolyAfterTouch);
   Serial.println("USB HOST MIDI Class Compliant Listening");
 
   //MIDI 5 Pin DIN
@@ -145,10 +187,12 @@ void setup() {
   MIDI.setHandlePitchBend(myPitchBend);
   MIDI.setHandleControlChange(myControlChange);
   MIDI.setHandleAfterTouchChannel(myAfterTouch);
+  MIDI.setHandleAfterTouchPoly(myPolyAfterTouch);
   MIDI.setHandleClock(myClock);
   MIDI.setHandleStart(myStart);
   MIDI.setHandleStop(myStop);
   MIDI.setHandleContinue(myContinue);
+  MIDI.setHandleSongPosition(mySongPosition);
   Serial.println("MIDI In DIN Listening");
 
   //USB Client MIDI
@@ -157,21 +201,22 @@ void setup() {
   usbMIDI.setHandleNoteOn(myNoteOn);
   usbMIDI.setHandlePitchChange(myPitchBend);
   usbMIDI.setHandleAfterTouchChannel(myAfterTouch);
+  usbMIDI.setHandleAfterTouchPoly(myPolyAfterTouch);
   usbMIDI.setHandleClock(myClock);
   usbMIDI.setHandleStart(myStart);
   usbMIDI.setHandleStop(myStop);
   usbMIDI.setHandleContinue(myContinue);
+  usbMIDI.setHandleSongPosition(myUsbSongPosition);
   Serial.println("USB Client MIDI Listening");
 
-  // Read Settings from EEPROM
-  for (int i = 0; i < 8; i++) {
-    EEPROM.get(ADDR_SF_ADJUST + i * sizeof(float), sfAdj[i]);
-    if ((sfAdj[i] < 0.9f) || (sfAdj[i] > 1.1f) || isnan(sfAdj[i])) sfAdj[i] = 1.0f;
-  }
-
   // Keyboard mode
   keyboardMode = EEPROM.read(ADDR_KEYBOARD_MODE);
 
+  // Voice chain
+  chainMode = getChainMode();
+  chainUnits = getChainUnits();
+  setupChain();
+
   // MIDI Channel
   midiChannel = EEPROM.read(EEPROM_MIDI_CH);
   gateChannel = EEPROM.read(EEPROM_GATE_CH);
@@ -192,24 +237,20 @@ void setup() {
   if (octave == 3) realoctave = 12;
   if (octave == 4) realoctave = 24;
 
-  sr.set(CLOCK_RESET, LOW);
+  srSet(CLOCK_RESET, LOW);
+
+  patchName.reserve(PATCH_NAME_SIZE);
+  renamedPatch.reserve(PATCH_NAME_SIZE);
 
   recallPatch(1);
+  if (clockSource == CLOCK_INTERNAL) masterStart();
+  heapGuardArm();
 }
 
 void myClock() {
-  if (millis() > clock_timeout + 300) clock_count = 0;  // Prevents Clock from starting in between quarter notes after clock is restarted!
-  clock_timeout = millis();
-
-  if (clock_count == 0) {
-    //digitalWriteFast(CLOCK_LED, HIGH);  // Start clock pulse
-    sr.set(CLOCK_LED, HIGH);
-    clock_timer = millis();
-  }
-  clock_count++;
-  if (clock_count == 24) {  // MIDI timing clock sends 24 pulses per quarter note.  Sent pulse only once every 24 pulses
-    clock_count = 0;
-  }
+  ProfileScope profile(PROF_CLOCK);
+  clockExternal();
+  clockTick();
 }
 
 // void myClock() {
@@ -224,117 +265,164 @@ void myClock() {
 // }
 
 void myStart() {
-  Clock = 0;
-  sr.set(RESET, HIGH);
+  ProfileScope profile(PROF_TRANSPORT);
+  clockStart();
+  srSet(RESET, HIGH);
   reset_timer = millis();
 }
 
 void myStop() {
-  sr.set(CLOCK_RESET, HIGH);
-  sr.set(CLOCK_LED, LOW);
-  sr.set(CLOCK_RESET, LOW);
+  ProfileScope profile(PROF_TRANSPORT);
+  clockStop();
+  srSet(CLOCK_RESET, HIGH);
+  srSet(CLOCK_LED, LOW);
+  srSet(CLOCK_RESET, LOW);
 }
 
 void myContinue() {
-  Clock = 0;
+  ProfileScope profile(PROF_TRANSPORT);
+  clockContinue();
+}
+
+void mySongPosition(unsigned beats) {
+  ProfileScope profile(PROF_TRANSPORT);
+  clockSongPosition(beats);
+}
+
+void myUsbSongPosition(uint16_t beats) {
+  mySongPosition(beats);
 }
 
 void myPitchBend(byte channel, int bend) {
+  ProfileScope profile(PROF_PITCH_BEND);
+  modSource(modSlot(MOD_BEND), channel, 0, bend);
+  if (mpePitchBend(channel, bend)) return;
   if (channel == midiChannel) {
+    setPitchBend(bend);
     int newbend = map(bend, -8191, 8192, 0, 3087);
-    analogWrite(PITCHBEND, newbend);
-    sr.set(PITCHBEND_LED, HIGH);
+    outputSet(OUT_PITCHBEND, newbend);
+    ledSet(PITCHBEND_LED);
     pitchbend_timer = millis();
   }
 }
 
 void myControlChange(byte channel, byte number, byte value) {
+  ProfileScope profile(PROF_CONTROL_CHANGE);
+  modSource(number & 0x7F, channel, 0, value << 7);
+  cc14In(channel, number, value);
+  nrpnIn(channel, number, value);
+  mpeConfigIn(channel, number, value);
+  if (number == MPE_TIMBRE_CC && mpeExpressionIn(channel, MPE_TIMBRE, value)) return;
+
   if (channel == midiChannel) {
+    if (number == PEDAL_CC_SUSTAIN) setSustain(value >= 64);
+    if (number == PEDAL_CC_SOSTENUTO) setSostenuto(value >= 64);
+
     if (number == 1) {
-      int newvalue = value;
-      newvalue = map(newvalue, 0, 127, 0, 7720);
-      analogWrite(WHEEL, newvalue);
-      sr.set(MOD_LED, HIGH);
+      outputSet(OUT_WHEEL, curveCode(OUT_WHEEL, value, 7720));
+      ledSet(MOD_LED);
       mod_timer = millis();
     }
 
     if (number == 2) {
-      int newvalue = value;
-      newvalue = map(newvalue, 0, 127, 0, 7720);
-      analogWrite(BREATH, newvalue);
-      sr.set(BREATH_LED, HIGH);
+      outputSet(OUT_BREATH, curveCode(OUT_BREATH, value, 7720));
+      ledSet(BREATH_LED);
       breath_timer = millis();
     }
+
+    if (number == CCglideSpeed) {
+      setGlideTime(value * value * GLIDE_MAX_MS / (127 * 127));
+    }
   }
 
   for (int i = 0; i < 16; i++) {
-    if ((CC_MAP[i][2] == 0 && CC_MAP[i][4] == 2) || (CC_MAP[i][2] == 0 && CC_MAP[i][4] == 3)) {
+    if ((CC_MAP[i][2] == 0 && CC_MAP[i][4] == 2) || (CC_MAP[i][2] == 0 && CC_MAP[i][4] == 3) || (CC_MAP[i][2] == 0 && CC_MAP[i][4] == QUANT_CC_MODE)) {
       if (CC_MAP[i][1] == channel && CC_MAP[i][0] == number) {
-        int newvalue = value;
+        if (CC_MAP[i][4] == QUANT_CC_MODE) {
+          outputSet(i, quantCode(i, value << 7));
+          ledSet(CC_MAP[i][5]);
+          outputLEDS[i] = millis();
+        }
 
         if (CC_MAP[i][4] == 2) {
-          newvalue = map(newvalue, 0, 127, 0, 7720);
-          analogWrite(CC_MAP[i][3], newvalue);
-          sr.set(CC_MAP[i][5], HIGH);
+          outputSet(i, curveCode(i, value, 7720));
+          ledSet(CC_MAP[i][5]);
           outputLEDS[i] = millis();
         }
 
         if (CC_MAP[i][4] == 3) {
-          newvalue = map(newvalue, 0, 127, 0, 15440);
-          analogWrite(CC_MAP[i][3], newvalue);
-          sr.set(CC_MAP[i][5], HIGH);
+          outputSet(i, curveCode(i, value, 15440));
+          ledSet(CC_MAP[i][5]);
           outputLEDS[i] = millis();
         }
       }
     }
   }
 
+  // NRPN and 14 bit CC pairs, the MSB is held until its LSB completes it
   for (int i = 0; i < 16; i++) {
-    if ((CC_MAP[i][2] == 0 && CC_MAP[i][4] == 4) || (CC_MAP[i][2] == 0 && CC_MAP[i][4] == 5)) {
-      if (CC_MAP[i][1] == channel && 99 == number) {
-        value99 = value;
-      }
-      if (CC_MAP[i][1] == channel && 98 == number) {
-        value98 = value;
-      }
-      if (CC_MAP[i][1] == channel && 6 == number) {
-        value6 = value;
-      }
-      if (CC_MAP[i][1] == channel && 38 == number) {
-        value38 = value;
-      }
+    if (CC_MAP[i][2] != 0 || CC_MAP[i][4] < 4 || CC_MAP[i][4] == QUANT_CC_MODE || CC_MAP[i][4] > QUANT_CC14_MODE || CC_MAP[i][1] != channel) continue;
 
-      if (CC_MAP[i][4] == 4) {
-        uint16_t combinedNumber = (value6 << 7) | value38;
-        combinedNumber = map(combinedNumber, 0, 1023, 0, 7720);
-        analogWrite(CC_MAP[i][3], combinedNumber);
-        sr.set(CC_MAP[i][5], HIGH);
-        outputLEDS[i] = millis();
+    if (CC_MAP[i][4] == 4 || CC_MAP[i][4] == 5) {
+      if (number == 6) {
+        hiresMsbIn(i, value);
+      } else if (number == 38) {
+        hiresLsbIn(i, value);
+      } else {
+        continue;
       }
-
-      if (CC_MAP[i][4] == 5) {
-        uint16_t combinedNumber = (value6 << 7) | value38;
-        combinedNumber = map(combinedNumber, 0, 1023, 0, 15440);
-        analogWrite(CC_MAP[i][3], combinedNumber);
-        sr.set(CC_MAP[i][5], HIGH);
-        outputLEDS[i] = millis();
+    } else {
+      if (number == CC_MAP[i][0]) {
+        hiresMsbIn(i, value);
+      } else if (CC_MAP[i][0] < 32 && number == CC_MAP[i][0] + 32) {
+        hiresLsbIn(i, value);
+      } else {
+        continue;
       }
     }
+    ledSet(CC_MAP[i][5]);
+    outputLEDS[i] = millis();
   }
 }
 
 void myAfterTouch(byte channel, byte value) {
+  ProfileScope profile(PROF_AFTERTOUCH);
+  modSource(modSlot(MOD_AFTERTOUCH), channel, 0, value << 7);
+  if (mpeExpressionIn(channel, MPE_PRESSURE, value)) return;
   if (channel == midiChannel) {
-    int newvalue = value;
-    newvalue = map(newvalue, 0, 127, 0, 7720);
-    analogWrite(AFTERTOUCH, newvalue);
-    sr.set(AFTERTOUCH_LED, HIGH);
+    outputSet(OUT_AFTERTOUCH, curveCode(OUT_AFTERTOUCH, value, 7720));
+    ledSet(AFTERTOUCH_LED);
     aftertouch_timer = millis();
   }
 }
 
+// Constant time per message, the note finds its voice through noteVoice
+void myPolyAfterTouch(byte channel, byte note, byte pressure) {
+  ProfileScope profile(PROF_POLY_AFTERTOUCH);
+  if (channel != midiChannel || polyAtMode == POLY_AT_OFF) return;
+  if (polyAtMode == POLY_AT_VOICES) {
+    int voice = noteVoice[note & 0x7F] - 1;
+    if (voice >= 0) velocitySet(voice, curveCode(CURVE_VELOCITY, pressure, 8191));
+  } else {
+    int i = polyAtMode - POLY_AT_OUTPUT;
+    outputSet(i, curveCode(i, pressure, 7720));
+    ledSet(CC_MAP[i][5]);
+    outputLEDS[i] = millis();
+  }
+}
+
+void updatePolyAtMode() {
+  if (polyAtMode == POLY_AT_OFF) {
+    showCurrentParameterPage("Poly AT", "Off");
+  } else if (polyAtMode == POLY_AT_VOICES) {
+    showCurrentParameterPage("Poly AT", "Voice Velocity");
+  } else {
+    showCurrentParameterNumber("Poly AT", "Output ", polyAtMode - POLY_AT_OUTPUT + 1);
+  }
+}
+
 void updatepolyCount() {
-  showCurrentParameterPage("Poly Count", String(polycount) + " Notes");
+  showCurrentParameterNumber("Poly Count", "", polycount, " Notes");
   freeGates = (8 - polycount);
   GATE_NOTES[0] = gate1;
   GATE_NOTES[1] = gate2;
@@ -344,6 +432,7 @@ void updatepolyCount() {
   GATE_NOTES[5] = gate6;
   GATE_NOTES[6] = gate7;
   GATE_NOTES[7] = gate8;
+  trigBuild();
 
   updateCCMAP();
 }
@@ -351,11 +440,11 @@ void updatepolyCount() {
 void updatechannel1() {
   switch (channel1) {
     case 0:
-      showCurrentParameterPage("Channel 1", "CC Number " + String(channel1_CC));
+      showCurrentParameterNumber("Channel 1", "CC Number ", channel1_CC);
       break;
 
     case 1:
-      showCurrentParameterPage("Channel 1", "MIDI Chan " + String(channel1_MIDI));
+      showCurrentParameterNumber("Channel 1", "MIDI Chan ", channel1_MIDI);
       break;
 
     case 2:
@@ -373,17 +462,45 @@ void updatechannel1() {
     case 5:
       showCurrentParameterPage("Channel 1", "NPRN 0-10V");
       break;
+
+    case 6:
+      showCurrentParameterPage("Channel 1", "CC14 0-5V");
+      break;
+
+    case 7:
+      showCurrentParameterPage("Channel 1", "CC14 0-10V");
+      break;
+
+    case 8:
+      showCurrentParameterPage("Channel 1", "Quant CC");
+      break;
+
+    case 9:
+      showCurrentParameterPage("Channel 1", "Quant CC14");
+      break;
+
+    case 10:
+      showCurrentParameterPage("Channel 1", "LFO");
+      break;
+
+    case 11:
+      showCurrentParameterPage("Channel 1", "Envelope");
+      break;
+
+    case 12:
+      showCurrentParameterPage("Channel 1", "Accent");
+      break;
   }
 }
 
 void updatechannel2() {
   switch (channel2_CC) {
     case 0:
-      showCurrentParameterPage("Channel 2", "CC Number " + String(channel2_CC));
+      showCurrentParameterNumber("Channel 2", "CC Number ", channel2_CC);
       break;
 
     case 1:
-      showCurrentParameterPage("Channel 2", "MIDI Chan " + String(channel2_MIDI));
+      showCurrentParameterNumber("Channel 2", "MIDI Chan ", channel2_MIDI);
       break;
 
     case 2:
@@ -401,17 +518,45 @@ void updatechannel2() {
     case 5:
       showCurrentParameterPage("Channel 2", "NPRN 0-10V");
       break;
+
+    case 6:
+      showCurrentParameterPage("Channel 2", "CC14 0-5V");
+      break;
+
+    case 7:
+      showCurrentParameterPage("Channel 2", "CC14 0-10V");
+      break;
+
+    case 8:
+      showCurrentParameterPage("Channel 2", "Quant CC");
+      break;
+
+    case 9:
+      showCurrentParameterPage("Channel 2", "Quant CC14");
+      break;
+
+    case 10:
+      showCurrentParameterPage("Channel 2", "LFO");
+      break;
+
+    case 11:
+      showCurrentParameterPage("Channel 2", "Envelope");
+      break;
+
+    case 12:
+      showCurrentParameterPage("Channel 2", "Accent");
+      break;
   }
 }
 
 void updatechannel3() {
   switch (channel3) {
     case 0:
-      showCurrentParameterPage("Channel 3", "CC Number " + String(channel3_CC));
+      showCurrentParameterNumber("Channel 3", "CC Number ", channel3_CC);
       break;
 
     case 1:
-      showCurrentParameterPage("Channel 3", "MIDI Chan " + String(channel3_MIDI));
+      showCurrentParameterNumber("Channel 3", "MIDI Chan ", channel3_MIDI);
       break;
 
     case 2:
@@ -429,17 +574,45 @@ void updatechannel3() {
     case 5:
       showCurrentParameterPage("Channel 3", "NPRN 0-10V");
       break;
+
+    case 6:
+      showCurrentParameterPage("Channel 3", "CC14 0-5V");
+      break;
+
+    case 7:
+      showCurrentParameterPage("Channel 3", "CC14 0-10V");
+      break;
+
+    case 8:
+      showCurrentParameterPage("Channel 3", "Quant CC");
+      break;
+
+    case 9:
+      showCurrentParameterPage("Channel 3", "Quant CC14");
+      break;
+
+    case 10:
+      showCurrentParameterPage("Channel 3", "LFO");
+      break;
+
+    case 11:
+      showCurrentParameterPage("Channel 3", "Envelope");
+      break;
+
+    case 12:
+      showCurrentParameterPage("Channel 3", "Accent");
+      break;
   }
 }
 
 void updatechannel4() {
   switch (channel4) {
     case 0:
-      showCurrentParameterPage("Channel 4", "CC Number " + String(channel4_CC));
+      showCurrentParameterNumber("Channel 4", "CC Number ", channel4_CC);
       break;
 
     case 1:
-      showCurrentParameterPage("Channel 4", "MIDI Chan " + String(channel4_MIDI));
+      showCurrentParameterNumber("Channel 4", "MIDI Chan ", channel4_MIDI);
       break;
 
     case 2:
@@ -457,17 +630,45 @@ void updatechannel4() {
     case 5:
       showCurrentParameterPage("Channel 4", "NPRN 0-10V");
       break;
+
+    case 6:
+      showCurrentParameterPage("Channel 4", "CC14 0-5V");
+      break;
+
+    case 7:
+      showCurrentParameterPage("Channel 4", "CC14 0-10V");
+      break;
+
+    case 8:
+      showCurrentParameterPage("Channel 4", "Quant CC");
+      break;
+
+    case 9:
+      showCurrentParameterPage("Channel 4", "Quant CC14");
+      break;
+
+    case 10:
+      showCurrentParameterPage("Channel 4", "LFO");
+      break;
+
+    case 11:
+      showCurrentParameterPage("Channel 4", "Envelope");
+      break;
+
+    case 12:
+      showCurrentParameterPage("Channel 4", "Accent");
+      break;
   }
 }
 
 void updatechannel5() {
   switch (channel5) {
     case 0:
-      showCurrentParameterPage("Channel 5", "CC Number " + String(channel5_CC));
+      showCurrentParameterNumber("Channel 5", "CC Number ", channel5_CC);
       break;
 
     case 1:
-      showCurrentParameterPage("Channel 5", "MIDI Chan " + String(channel5_MIDI));
+      showCurrentParameterNumber("Channel 5", "MIDI Chan ", channel5_MIDI);
       break;
 
     case 2:
@@ -485,17 +686,45 @@ void updatechannel5() {
     case 5:
       showCurrentParameterPage("Channel 5", "NPRN 0-10V");
       break;
+
+    case 6:
+      showCurrentParameterPage("Channel 5", "CC14 0-5V");
+      break;
+
+    case 7:
+      showCurrentParameterPage("Channel 5", "CC14 0-10V");
+      break;
+
+    case 8:
+      showCurrentParameterPage("Channel 5", "Quant CC");
+      break;
+
+    case 9:
+      showCurrentParameterPage("Channel 5", "Quant CC14");
+      break;
+
+    case 10:
+      showCurrentParameterPage("Channel 5", "LFO");
+      break;
+
+    case 11:
+      showCurrentParameterPage("Channel 5", "Envelope");
+      break;
+
+    case 12:
+      showCurrentParameterPage("Channel 5", "Accent");
+      break;
   }
 }
 
 void updatechannel6() {
   switch (channel6) {
     case 0:
-      showCurrentParameterPage("Channel 6", "CC Number " + String(channel6_CC));
+      showCurrentParameterNumber("Channel 6", "CC Number ", channel6_CC);
       break;
 
     case 1:
-      showCurrentParameterPage("Channel 6", "MIDI Chan " + String(channel6_MIDI));
+      showCurrentParameterNumber("Channel 6", "MIDI Chan ", channel6_MIDI);
       break;
 
     case 2:
@@ -513,17 +742,45 @@ void updatechannel6() {
     case 5:
       showCurrentParameterPage("Channel 6", "NPRN 0-10V");
       break;
+
+    case 6:
+      showCurrentParameterPage("Channel 6", "CC14 0-5V");
+      break;
+
+    case 7:
+      showCurrentParameterPage("Channel 6", "CC14 0-10V");
+      break;
+
+    case 8:
+      showCurrentParameterPage("Channel 6", "Quant CC");
+      break;
+
+    case 9:
+      showCurrentParameterPage("Channel 6", "Quant CC14");
+      break;
+
+    case 10:
+      showCurrentParameterPage("Channel 6", "LFO");
+      break;
+
+    case 11:
+      showCurrentParameterPage("Channel 6", "Envelope");
+      break;
+
+    case 12:
+      showCurrentParameterPage("Channel 6", "Accent");
+      break;
   }
 }
 
 void updatechannel7() {
   switch (channel7) {
     case 0:
-      showCurrentParameterPage("Channel 7", "CC Number " + String(channel7_CC));
+      showCurrentParameterNumber("Channel 7", "CC Number ", channel7_CC);
       break;
 
     case 1:
-      showCurrentParameterPage("Channel 7", "MIDI Chan " + String(channel7_MIDI));
+      showCurrentParameterNumber("Channel 7", "MIDI Chan ", channel7_MIDI);
       break;
 
     case 2:
@@ -541,17 +798,45 @@ void updatechannel7() {
     case 5:
       showCurrentParameterPage("Channel 7", "NPRN 0-10V");
       break;
+
+    case 6:
+      showCurrentParameterPage("Channel 7", "CC14 0-5V");
+      break;
+
+    case 7:
+      showCurrentParameterPage("Channel 7", "CC14 0-10V");
+      break;
+
+    case 8:
+      showCurrentParameterPage("Channel 7", "Quant CC");
+      break;
+
+    case 9:
+      showCurrentParameterPage("Channel 7", "Quant CC14");
+      break;
+
+    case 10:
+      showCurrentParameterPage("Channel 7", "LFO");
+      break;
+
+    case 11:
+      showCurrentParameterPage("Channel 7", "Envelope");
+      break;
+
+    case 12:
+      showCurrentParameterPage("Channel 7", "Accent");
+      break;
   }
 }
 
 void updatechannel8() {
   switch (channel8) {
     case 0:
-      showCurrentParameterPage("Channel 8", "CC Number " + String(channel8_CC));
+      showCurrentParameterNumber("Channel 8", "CC Number ", channel8_CC);
       break;
 
     case 1:
-      showCurrentParameterPage("Channel 8", "MIDI Chan " + String(channel8_MIDI));
+      showCurrentParameterNumber("Channel 8", "MIDI Chan ", channel8_MIDI);
       break;
 
     case 2:
@@ -569,17 +854,45 @@ void updatechannel8() {
     case 5:
       showCurrentParameterPage("Channel 8", "NPRN 0-10V");
       break;
+
+    case 6:
+      showCurrentParameterPage("Channel 8", "CC14 0-5V");
+      break;
+
+    case 7:
+      showCurrentParameterPage("Channel 8", "CC14 0-10V");
+      break;
+
+    case 8:
+      showCurrentParameterPage("Channel 8", "Quant CC");
+      break;
+
+    case 9:
+      showCurrentParameterPage("Channel 8", "Quant CC14");
+      break;
+
+    case 10:
+      showCurrentParameterPage("Channel 8", "LFO");
+      break;
+
+    case 11:
+      showCurrentParameterPage("Channel 8", "Envelope");
+      break;
+
+    case 12:
+      showCurrentParameterPage("Channel 8", "Accent");
+      break;
   }
 }
 
 void updatechannel9() {
   switch (channel9) {
     case 0:
-      showCurrentParameterPage("Channel 9", "CC Number " + String(channel9_CC));
+      showCurrentParameterNumber("Channel 9", "CC Number ", channel9_CC);
       break;
 
     case 1:
-      showCurrentParameterPage("Channel 9", "MIDI Chan " + String(channel9_MIDI));
+      showCurrentParameterNumber("Channel 9", "MIDI Chan ", channel9_MIDI);
       break;
 
     case 2:
@@ -597,17 +910,45 @@ void updatechannel9() {
     case 5:
       showCurrentParameterPage("Channel 9", "NPRN 0-10V");
       break;
+
+    case 6:
+      showCurrentParameterPage("Channel 9", "CC14 0-5V");
+      break;
+
+    case 7:
+      showCurrentParameterPage("Channel 9", "CC14 0-10V");
+      break;
+
+    case 8:
+      showCurrentParameterPage("Channel 9", "Quant CC");
+      break;
+
+    case 9:
+      showCurrentParameterPage("Channel 9", "Quant CC14");
+      break;
+
+    case 10:
+      showCurrentParameterPage("Channel 9", "LFO");
+      break;
+
+    case 11:
+      showCurrentParameterPage("Channel 9", "Envelope");
+      break;
+
+    case 12:
+      showCurrentParameterPage("Channel 9", "Accent");
+      break;
   }
 }
 
 void updatechannel10() {
   switch (channel10) {
     case 0:
-      showCurrentParameterPage("Channel 10", "CC Number " + String(channel10_CC));
+      showCurrentParameterNumber("Channel 10", "CC Number ", channel10_CC);
       break;
 
     case 1:
-      showCurrentParameterPage("Channel 10", "MIDI Chan " + String(channel10_MIDI));
+      showCurrentParameterNumber("Channel 10", "MIDI Chan ", channel10_MIDI);
       break;
 
     case 2:
@@ -625,17 +966,45 @@ void updatechannel10() {
     case 5:
       showCurrentParameterPage("Channel 10", "NPRN 0-10V");
       break;
+
+    case 6:
+      showCurrentParameterPage("Channel 10", "CC14 0-5V");
+      break;
+
+    case 7:
+      showCurrentParameterPage("Channel 10", "CC14 0-10V");
+      break;
+
+    case 8:
+      showCurrentParameterPage("Channel 10", "Quant CC");
+      break;
+
+    case 9:
+      showCurrentParameterPage("Channel 10", "Quant CC14");
+      break;
+
+    case 10:
+      showCurrentParameterPage("Channel 10", "LFO");
+      break;
+
+    case 11:
+      showCurrentParameterPage("Channel 10", "Envelope");
+      break;
+
+    case 12:
+      showCurrentParameterPage("Channel 10", "Accent");
+      break;
   }
 }
 
 void updatechannel11() {
   switch (channel11) {
     case 0:
-      showCurrentParameterPage("Channel 11", "CC Number " + String(channel11_CC));
+      showCurrentParameterNumber("Channel 11", "CC Number ", channel11_CC);
       break;
 
     case 1:
-      showCurrentParameterPage("Channel 11", "MIDI Chan " + String(channel11_MIDI));
+      showCurrentParameterNumber("Channel 11", "MIDI Chan ", channel11_MIDI);
       break;
 
     case 2:
@@ -653,17 +1022,45 @@ void updatechannel11() {
     case 5:
       showCurrentParameterPage("Channel 11", "NPRN 0-10V");
       break;
+
+    case 6:
+      showCurrentParameterPage("Channel 11", "CC14 0-5V");
+      break;
+
+    case 7:
+      showCurrentParameterPage("Channel 11", "CC14 0-10V");
+      break;
+
+    case 8:
+      showCurrentParameterPage("Channel 11", "Quant CC");
+      break;
+
+    case 9:
+      showCurrentParameterPage("Channel 11", "Quant CC14");
+      break;
+
+    case 10:
+      showCurrentParameterPage("Channel 11", "LFO");
+      break;
+
+    case 11:
+      showCurrentParameterPage("Channel 11", "Envelope");
+      break;
+
+    case 12:
+      showCurrentParameterPage("Channel 11", "Accent");
+      break;
   }
 }
 
 void updatechannel12() {
   switch (channel12) {
     case 0:
-      showCurrentParameterPage("Channel 12", "CC Number " + String(channel12_CC));
+      showCurrentParameterNumber("Channel 12", "CC Number ", channel12_CC);
       break;
 
     case 1:
-      showCurrentParameterPage("Channel 12", "MIDI Chan " + String(channel12_MIDI));
+      showCurrentParameterNumber("Channel 12", "MIDI Chan ", channel12_MIDI);
       break;
 
     case 2:
@@ -681,17 +1078,45 @@ void updatechannel12() {
     case 5:
       showCurrentParameterPage("Channel 12", "NPRN 0-10V");
       break;
+
+    case 6:
+      showCurrentParameterPage("Channel 12", "CC14 0-5V");
+      break;
+
+    case 7:
+      showCurrentParameterPage("Channel 12", "CC14 0-10V");
+      break;
+
+    case 8:
+      showCurrentParameterPage("Channel 12", "Quant CC");
+      break;
+
+    case 9:
+      showCurrentParameterPage("Channel 12", "Quant CC14");
+      break;
+
+    case 10:
+      showCurrentParameterPage("Channel 12", "LFO");
+      break;
+
+    case 11:
+      showCurrentParameterPage("Channel 12", "Envelope");
+      break;
+
+    case 12:
+      showCurrentParameterPage("Channel 12", "Accent");
+      break;
   }
 }
 
 void updatechannel13() {
   switch (channel13) {
     case 0:
-      showCurrentParameterPage("Channel 13", "CC Number " + String(channel13_CC));
+      showCurrentParameterNumber("Channel 13", "CC Number ", channel13_CC);
       break;
 
     case 1:
-      showCurrentParameterPage("Channel 13", "MIDI Chan " + String(channel13_MIDI));
+      showCurrentParameterNumber("Channel 13", "MIDI Chan ", channel13_MIDI);
       break;
 
     case 2:
@@ -709,17 +1134,45 @@ void updatechannel13() {
     case 5:
       showCurrentParameterPage("Channel 13", "NPRN 0-10V");
       break;
+
+    case 6:
+      showCurrentParameterPage("Channel 13", "CC14 0-5V");
+      break;
+
+    case 7:
+      showCurrentParameterPage("Channel 13", "CC14 0-10V");
+      break;
+
+    case 8:
+      showCurrentParameterPage("Channel 13", "Quant CC");
+      break;
+
+    case 9:
+      showCurrentParameterPage("Channel 13", "Quant CC14");
+      break;
+
+    case 10:
+      showCurrentParameterPage("Channel 13", "LFO");
+      break;
+
+    case 11:
+      showCurrentParameterPage("Channel 13", "Envelope");
+      break;
+
+    case 12:
+      showCurrentParameterPage("Channel 13", "Accent");
+      break;
   }
 }
 
 void updatechannel14() {
   switch (channel14) {
     case 0:
-      showCurrentParameterPage("Channel 14", "CC Number " + String(channel14_CC));
+      showCurrentParameterNumber("Channel 14", "CC Number ", channel14_CC);
       break;
 
     case 1:
-      showCurrentParameterPage("Channel 14", "MIDI Chan " + String(channel14_MIDI));
+      showCurrentParameterNumber("Channel 14", "MIDI Chan ", channel14_MIDI);
       break;
 
     case 2:
@@ -737,17 +1190,45 @@ void updatechannel14() {
     case 5:
       showCurrentParameterPage("Channel 14", "NPRN 0-10V");
       break;
+
+    case 6:
+      showCurrentParameterPage("Channel 14", "CC14 0-5V");
+      break;
+
+    case 7:
+      showCurrentParameterPage("Channel 14", "CC14 0-10V");
+      break;
+
+    case 8:
+      showCurrentParameterPage("Channel 14", "Quant CC");
+      break;
+
+    case 9:
+      showCurrentParameterPage("Channel 14", "Quant CC14");
+      break;
+
+    case 10:
+      showCurrentParameterPage("Channel 14", "LFO");
+      break;
+
+    case 11:
+      showCurrentParameterPage("Channel 14", "Envelope");
+      break;
+
+    case 12:
+      showCurrentParameterPage("Channel 14", "Accent");
+      break;
   }
 }
 
 void updatechannel15() {
   switch (channel15) {
     case 0:
-      showCurrentParameterPage("Channel 15", "CC Number " + String(channel15_CC));
+      showCurrentParameterNumber("Channel 15", "CC Number ", channel15_CC);
       break;
 
     case 1:
-      showCurrentParameterPage("Channel 15", "MIDI Chan " + String(channel15_MIDI));
+      showCurrentParameterNumber("Channel 15", "MIDI Chan ", channel15_MIDI);
       break;
 
     case 2:
@@ -765,17 +1246,45 @@ void updatechannel15() {
     case 5:
       showCurrentParameterPage("Channel 15", "NPRN 0-10V");
       break;
+
+    case 6:
+      showCurrentParameterPage("Channel 15", "CC14 0-5V");
+      break;
+
+    case 7:
+      showCurrentParameterPage("Channel 15", "CC14 0-10V");
+      break;
+
+    case 8:
+      showCurrentParameterPage("Channel 15", "Quant CC");
+      break;
+
+    case 9:
+      showCurrentParameterPage("Channel 15", "Quant CC14");
+      break;
+
+    case 10:
+      showCurrentParameterPage("Channel 15", "LFO");
+      break;
+
+    case 11:
+      showCurrentParameterPage("Channel 15", "Envelope");
+      break;
+
+    case 12:
+      showCurrentParameterPage("Channel 15", "Accent");
+      break;
   }
 }
 
 void updatechannel16() {
   switch (channel16) {
     case 0:
-      showCurrentParameterPage("Channel 16", "CC Number " + String(channel16_CC));
+      showCurrentParameterNumber("Channel 16", "CC Number ", channel16_CC);
       break;
 
     case 1:
-      showCurrentParameterPage("Channel 16", "MIDI Chan " + String(channel16_MIDI));
+      showCurrentParameterNumber("Channel 16", "MIDI Chan ", channel16_MIDI);
       break;
 
     case 2:
@@ -793,39 +1302,91 @@ void updatechannel16() {
     case 5:
       showCurrentParameterPage("Channel 16", "NPRN 0-10V");
       break;
+
+    case 6:
+      showCurrentParameterPage("Channel 16", "CC14 0-5V");
+      break;
+
+    case 7:
+      showCurrentParameterPage("Channel 16", "CC14 0-10V");
+      break;
+
+    case 8:
+      showCurrentParameterPage("Channel 16", "Quant CC");
+      break;
+
+    case 9:
+      showCurrentParameterPage("Channel 16", "Quant CC14");
+      break;
+
+    case 10:
+      showCurrentParameterPage("Channel 16", "LFO");
+      break;
+
+    case 11:
+      showCurrentParameterPage("Channel 16", "Envelope");
+      break;
+
+    case 12:
+      showCurrentParameterPage("Channel 16", "Accent");
+      break;
+  }
+}
+
+void showGateParameter(const char *name, int gate) {
+  if (gate > GATE_NOTE_MAX) {
+    showCurrentParameterPage(name, clockRateName(gate));
+  } else {
+    showCurrentParameterNumber(name, "Note ", gate);
   }
 }
 
 void updategate1() {
-  showCurrentParameterPage("Gate 1", "Note " + String(gate1));
+  showGateParameter("Gate 1", gate1);
+  GATE_NOTES[0] = gate1;
+  trigBuild();
 }
 
 void updategate2() {
-  showCurrentParameterPage("Gate 2", "Note " + String(gate2));
+  showGateParameter("Gate 2", gate2);
+  GATE_NOTES[1] = gate2;
+  trigBuild();
 }
 
 void updategate3() {
-  showCurrentParameterPage("Gate 3", "Note " + String(gate3));
+  showGateParameter("Gate 3", gate3);
+  GATE_NOTES[2] = gate3;
+  trigBuild();
 }
 
 void updategate4() {
-  showCurrentParameterPage("Gate 4", "Note " + String(gate4));
+  showGateParameter("Gate 4", gate4);
+  GATE_NOTES[3] = gate4;
+  trigBuild();
 }
 
 void updategate5() {
-  showCurrentParameterPage("Gate 5", "Note " + String(gate5));
+  showGateParameter("Gate 5", gate5);
+  GATE_NOTES[4] = gate5;
+  trigBuild();
 }
 
 void updategate6() {
-  showCurrentParameterPage("Gate 6", "Note " + String(gate6));
+  showGateParameter("Gate 6", gate6);
+  GATE_NOTES[5] = gate6;
+  trigBuild();
 }
 
 void updategate7() {
-  showCurrentParameterPage("Gate 7", "Note " + String(gate7));
+  showGateParameter("Gate 7", gate7);
+  GATE_NOTES[6] = gate7;
+  trigBuild();
 }
 
 void updategate8() {
-  showCurrentParameterPage("Gate 8", "Note " + String(gate8));
+  showGateParameter("Gate 8", gate8);
+  GATE_NOTES[7] = gate8;
+  trigBuild();
 }
 
 void commandTopNote() {
@@ -842,8 +1403,7 @@ void commandTopNote() {
   if (noteActive)
     commandNote(topNote);
   else  // All notes are off, turn off gate
-    sr.set(GATE_NOTE1, LOW);
-  sr.set(NOTE1_LED, LOW);
+    gateOff(0);
 }
 
 void commandBottomNote() {
@@ -860,8 +1420,7 @@ void commandBottomNote() {
   if (noteActive)
     commandNote(bottomNote);
   else  // All notes are off, turn off gate
-    sr.set(GATE_NOTE1, LOW);
-  sr.set(NOTE1_LED, LOW);
+    gateOff(0);
 }
 
 void commandLastNote() {
@@ -875,15 +1434,13 @@ void commandLastNote() {
       return;
     }
   }
-  sr.set(GATE_NOTE1, LOW);  // All notes are off
-  sr.set(NOTE1_LED, LOW);
+  gateOff(0);  // All notes are off
 }
 
 void commandNote(int noteMsg) {
-  unsigned int mV = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[0] + 0.5);
-  analogWrite(NOTE1, mV);
-  sr.set(GATE_NOTE1, HIGH);
-  sr.set(NOTE1_LED, HIGH);
+  unsigned int mV = noteCodeFor(0, noteMsg);
+  glideTo(0, mV);
+  gateOn(0, noteRetrigger);
 }
 
 void commandTopNoteUni() {
@@ -938,299 +1495,142 @@ void commandLastNoteUni() {
 }
 
 void updateGates(int gatestate) {
-  switch (polycount) {
-    case 1:
-      sr.set(GATE_NOTE1, gatestate);
-      sr.set(NOTE1_LED, gatestate);
-      break;
-
-    case 2:
-      sr.set(GATE_NOTE1, gatestate);
-      sr.set(GATE_NOTE2, gatestate);
-      sr.set(NOTE1_LED, gatestate);
-      sr.set(NOTE2_LED, gatestate);
-      break;
-
-    case 3:
-      sr.set(GATE_NOTE1, gatestate);
-      sr.set(GATE_NOTE2, gatestate);
-      sr.set(GATE_NOTE3, gatestate);
-      sr.set(NOTE1_LED, gatestate);
-      sr.set(NOTE2_LED, gatestate);
-      sr.set(NOTE3_LED, gatestate);
-      break;
-
-    case 4:
-      sr.set(GATE_NOTE1, gatestate);
-      sr.set(GATE_NOTE2, gatestate);
-      sr.set(GATE_NOTE3, gatestate);
-      sr.set(GATE_NOTE4, gatestate);
-      sr.set(NOTE1_LED, gatestate);
-      sr.set(NOTE2_LED, gatestate);
-      sr.set(NOTE3_LED, gatestate);
-      sr.set(NOTE4_LED, gatestate);
-      break;
-
-    case 5:
-      sr.set(GATE_NOTE1, gatestate);
-      sr.set(GATE_NOTE2, gatestate);
-      sr.set(GATE_NOTE3, gatestate);
-      sr.set(GATE_NOTE4, gatestate);
-      sr.set(GATE_NOTE5, gatestate);
-      sr.set(NOTE1_LED, gatestate);
-      sr.set(NOTE2_LED, gatestate);
-      sr.set(NOTE3_LED, gatestate);
-      sr.set(NOTE4_LED, gatestate);
-      sr.set(NOTE5_LED, gatestate);
-      break;
-
-    case 6:
-      sr.set(GATE_NOTE1, gatestate);
-      sr.set(GATE_NOTE2, gatestate);
-      sr.set(GATE_NOTE3, gatestate);
-      sr.set(GATE_NOTE4, gatestate);
-      sr.set(GATE_NOTE5, gatestate);
-      sr.set(GATE_NOTE6, gatestate);
-      sr.set(NOTE1_LED, gatestate);
-      sr.set(NOTE2_LED, gatestate);
-      sr.set(NOTE3_LED, gatestate);
-      sr.set(NOTE4_LED, gatestate);
-      sr.set(NOTE5_LED, gatestate);
-      sr.set(NOTE6_LED, gatestate);
-      break;
-
-    case 7:
-      sr.set(GATE_NOTE1, gatestate);
-      sr.set(GATE_NOTE2, gatestate);
-      sr.set(GATE_NOTE3, gatestate);
-      sr.set(GATE_NOTE4, gatestate);
-      sr.set(GATE_NOTE5, gatestate);
-      sr.set(GATE_NOTE6, gatestate);
-      sr.set(GATE_NOTE7, gatestate);
-      sr.set(NOTE1_LED, gatestate);
-      sr.set(NOTE2_LED, gatestate);
-      sr.set(NOTE3_LED, gatestate);
-      sr.set(NOTE4_LED, gatestate);
-      sr.set(NOTE5_LED, gatestate);
-      sr.set(NOTE6_LED, gatestate);
-      sr.set(NOTE7_LED, gatestate);
-      break;
-
-    case 8:
-      sr.set(GATE_NOTE1, gatestate);
-      sr.set(GATE_NOTE2, gatestate);
-      sr.set(GATE_NOTE3, gatestate);
-      sr.set(GATE_NOTE4, gatestate);
-      sr.set(GATE_NOTE5, gatestate);
-      sr.set(GATE_NOTE6, gatestate);
-      sr.set(GATE_NOTE7, gatestate);
-      sr.set(GATE_NOTE8, gatestate);
-      sr.set(NOTE1_LED, gatestate);
-      sr.set(NOTE2_LED, gatestate);
-      sr.set(NOTE3_LED, gatestate);
-      sr.set(NOTE4_LED, gatestate);
-      sr.set(NOTE5_LED, gatestate);
-      sr.set(NOTE6_LED, gatestate);
-      sr.set(NOTE7_LED, gatestate);
-      sr.set(NOTE8_LED, gatestate);
+  for (int i = 0; i < polycount; i++) {
+    if (gatestate) {
+      gateOn(i, noteRetrigger);
+    } else {
+      gateOff(i);
+    }
   }
 }
 
 void commandNoteUni(int noteMsg) {
   switch (polycount) {
     case 1:
-      mV1 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[0] + 0.5);
-      analogWrite(NOTE1, mV1);
+      mV1 = noteCodeFor(0, noteMsg);
+      glideTo(0, mV1);
       updateGates(1);
       break;
 
     case 2:
-      mV1 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[0] + 0.5);
-      analogWrite(NOTE1, mV1);
-      mV2 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[1] + 0.5);
-      analogWrite(NOTE2, mV2);
+      mV1 = noteCodeFor(0, noteMsg);
+      glideTo(0, mV1);
+      mV2 = noteCodeFor(1, noteMsg);
+      glideTo(1, mV2);
       updateGates(1);
       break;
 
     case 3:
-      mV1 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[0] + 0.5);
-      analogWrite(NOTE1, mV1);
-      mV2 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[1] + 0.5);
-      analogWrite(NOTE2, mV2);
-      mV3 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[2] + 0.5);
-      analogWrite(NOTE3, mV3);
+      mV1 = noteCodeFor(0, noteMsg);
+      glideTo(0, mV1);
+      mV2 = noteCodeFor(1, noteMsg);
+      glideTo(1, mV2);
+      mV3 = noteCodeFor(2, noteMsg);
+      glideTo(2, mV3);
       updateGates(1);
       break;
 
     case 4:
-      mV1 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[0] + 0.5);
-      analogWrite(NOTE1, mV1);
-      mV2 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[1] + 0.5);
-      analogWrite(NOTE2, mV2);
-      mV3 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[2] + 0.5);
-      analogWrite(NOTE3, mV3);
-      mV4 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[3] + 0.5);
-      analogWrite(NOTE4, mV4);
+      mV1 = noteCodeFor(0, noteMsg);
+      glideTo(0, mV1);
+      mV2 = noteCodeFor(1, noteMsg);
+      glideTo(1, mV2);
+      mV3 = noteCodeFor(2, noteMsg);
+      glideTo(2, mV3);
+      mV4 = noteCodeFor(3, noteMsg);
+      glideTo(3, mV4);
       updateGates(1);
       break;
 
     case 5:
-      mV1 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[0] + 0.5);
-      analogWrite(NOTE1, mV1);
-      mV2 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[1] + 0.5);
-      analogWrite(NOTE2, mV2);
-      mV3 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[2] + 0.5);
-      analogWrite(NOTE3, mV3);
-      mV4 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[3] + 0.5);
-      analogWrite(NOTE4, mV4);
-      mV5 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[4] + 0.5);
-      analogWrite(NOTE5, mV5);
+      mV1 = noteCodeFor(0, noteMsg);
+      glideTo(0, mV1);
+      mV2 = noteCodeFor(1, noteMsg);
+      glideTo(1, mV2);
+      mV3 = noteCodeFor(2, noteMsg);
+      glideTo(2, mV3);
+      mV4 = noteCodeFor(3, noteMsg);
+      glideTo(3, mV4);
+      mV5 = noteCodeFor(4, noteMsg);
+      glideTo(4, mV5);
       updateGates(1);
       break;
 
     case 6:
-      mV1 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[0] + 0.5);
-      analogWrite(NOTE1, mV1);
-      mV2 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[1] + 0.5);
-      analogWrite(NOTE2, mV2);
-      mV3 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[2] + 0.5);
-      analogWrite(NOTE3, mV3);
-      mV4 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[3] + 0.5);
-      analogWrite(NOTE4, mV4);
-      mV5 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[4] + 0.5);
-      analogWrite(NOTE5, mV5);
-      mV6 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[5] + 0.5);
-      analogWrite(NOTE6, mV6);
+      mV1 = noteCodeFor(0, noteMsg);
+      glideTo(0, mV1);
+      mV2 = noteCodeFor(1, noteMsg);
+      glideTo(1, mV2);
+      mV3 = noteCodeFor(2, noteMsg);
+      glideTo(2, mV3);
+      mV4 = noteCodeFor(3, noteMsg);
+      glideTo(3, mV4);
+      mV5 = noteCodeFor(4, noteMsg);
+      glideTo(4, mV5);
+      mV6 = noteCodeFor(5, noteMsg);
+      glideTo(5, mV6);
       updateGates(1);
       break;
 
     case 7:
-      mV1 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[0] + 0.5);
-      analogWrite(NOTE1, mV1);
-      mV2 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[1] + 0.5);
-      analogWrite(NOTE2, mV2);
-      mV3 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[2] + 0.5);
-      analogWrite(NOTE3, mV3);
-      mV4 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[3] + 0.5);
-      analogWrite(NOTE4, mV4);
-      mV5 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[4] + 0.5);
-      analogWrite(NOTE5, mV5);
-      mV6 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[5] + 0.5);
-      analogWrite(NOTE6, mV6);
-      mV7 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[6] + 0.5);
-      analogWrite(NOTE7, mV7);
+      mV1 = noteCodeFor(0, noteMsg);
+      glideTo(0, mV1);
+      mV2 = noteCodeFor(1, noteMsg);
+      glideTo(1, mV2);
+      mV3 = noteCodeFor(2, noteMsg);
+      glideTo(2, mV3);
+      mV4 = noteCodeFor(3, noteMsg);
+      glideTo(3, mV4);
+      mV5 = noteCodeFor(4, noteMsg);
+      glideTo(4, mV5);
+      mV6 = noteCodeFor(5, noteMsg);
+      glideTo(5, mV6);
+      mV7 = noteCodeFor(6, noteMsg);
+      glideTo(6, mV7);
       updateGates(1);
       break;
 
     case 8:
-      mV1 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[0] + 0.5);
-      analogWrite(NOTE1, mV1);
-      mV2 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[1] + 0.5);
-      analogWrite(NOTE2, mV2);
-      mV3 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[2] + 0.5);
-      analogWrite(NOTE3, mV3);
-      mV4 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[3] + 0.5);
-      analogWrite(NOTE4, mV4);
-      mV5 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[4] + 0.5);
-      analogWrite(NOTE5, mV5);
-      mV6 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[5] + 0.5);
-      analogWrite(NOTE6, mV6);
-      mV7 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[6] + 0.5);
-      analogWrite(NOTE7, mV7);
-      mV8 = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF * sfAdj[7] + 0.5);
-      analogWrite(NOTE8, mV8);
+      mV1 = noteCodeFor(0, noteMsg);
+      glideTo(0, mV1);
+      mV2 = noteCodeFor(1, noteMsg);
+      glideTo(1, mV2);
+      mV3 = noteCodeFor(2, noteMsg);
+      glideTo(2, mV3);
+      mV4 = noteCodeFor(3, noteMsg);
+      glideTo(3, mV4);
+      mV5 = noteCodeFor(4, noteMsg);
+      glideTo(4, mV5);
+      mV6 = noteCodeFor(5, noteMsg);
+      glideTo(5, mV6);
+      mV7 = noteCodeFor(6, noteMsg);
+      glideTo(6, mV7);
+      mV8 = noteCodeFor(7, noteMsg);
+      glideTo(7, mV8);
       updateGates(1);
       break;
   }
 }
 
 void myNoteOn(byte channel, byte note, byte velocity) {
+  ProfileScope profile(PROF_NOTE_ON);
+  if (velocity > 0) {
+    modSource(modSlot(MOD_VELOCITY), channel, 0, velocity << 7);
+    modSource(modSlot(MOD_NOTE), channel, 0, note << 7);
+  }
+  if (mpeNoteOn(channel, note, velocity)) return;
+  if (seqNoteOn(channel, note, velocity)) return;
   if (channel == midiChannel) {
     //Check for out of range notes
     if (note < 0 || note > 127) return;
 
     prevNote = note;
+    noteRetrigger = velocity > 0;  //Mono and unison gates drop for the retrigger gap on a new note
     if (keyboardMode == 0) {
-      switch (getVoiceNo(-1)) {
-        case 1:
-          voices[0].note = note;
-          voices[0].velocity = velocity;
-          voices[0].timeOn = millis();
-          updateVoice1();
-          sr.set(GATE_NOTE1, HIGH);
-          sr.set(NOTE1_LED, HIGH);
-          voiceOn[0] = true;
-          break;
-
-        case 2:
-          voices[1].note = note;
-          voices[1].velocity = velocity;
-          voices[1].timeOn = millis();
-          updateVoice2();
-          sr.set(GATE_NOTE2, HIGH);
-          sr.set(NOTE2_LED, HIGH);
-          voiceOn[1] = true;
-          break;
-
-        case 3:
-          voices[2].note = note;
-          voices[2].velocity = velocity;
-          voices[2].timeOn = millis();
-          updateVoice3();
-          sr.set(GATE_NOTE3, HIGH);
-          sr.set(NOTE3_LED, HIGH);
-          voiceOn[2] = true;
-          break;
-
-        case 4:
-          voices[3].note = note;
-          voices[3].velocity = velocity;
-          voices[3].timeOn = millis();
-          updateVoice4();
-          sr.set(GATE_NOTE4, HIGH);
-          sr.set(NOTE4_LED, HIGH);
-          voiceOn[3] = true;
-          break;
-
-        case 5:
-          voices[4].note = note;
-          voices[4].velocity = velocity;
-          voices[4].timeOn = millis();
-          updateVoice5();
-          sr.set(GATE_NOTE5, HIGH);
-          sr.set(NOTE5_LED, HIGH);
-          voiceOn[4] = true;
-          break;
-
-        case 6:
-          voices[5].note = note;
-          voices[5].velocity = velocity;
-          voices[5].timeOn = millis();
-          updateVoice6();
-          sr.set(GATE_NOTE6, HIGH);
-          sr.set(NOTE6_LED, HIGH);
-          voiceOn[5] = true;
-          break;
-
-        case 7:
-          voices[6].note = note;
-          voices[6].velocity = velocity;
-          voices[6].timeOn = millis();
-          updateVoice7();
-          sr.set(GATE_NOTE7, HIGH);
-          sr.set(NOTE7_LED, HIGH);
-          voiceOn[6] = true;
-          break;
-
-        case 8:
-          voices[7].note = note;
-          voices[7].velocity = velocity;
-          voices[7].timeOn = millis();
-          updateVoice8();
-          sr.set(GATE_NOTE8, HIGH);
-          sr.set(NOTE8_LED, HIGH);
-          voiceOn[7] = true;
-          break;
+      if (chainMode == CHAIN_LEADER && chainUnits > 1) {
+        chainNoteOn(note, velocity);
+      } else if (chainMode < CHAIN_FOLLOWER1) {
+        voiceNoteOn(allocVoice(note), note, velocity);
       }
     } else if (keyboardMode == 4 || keyboardMode == 5 || keyboardMode == 6) {
       noteMsg = note;
@@ -1241,8 +1641,8 @@ void myNoteOn(byte channel, byte note, byte velocity) {
         notes[noteMsg] = true;
       }
 
-      unsigned int velmV = map(velocity, 0, 127, 0, 8191);
-      analogWrite(VELOCITY1, velmV);
+      unsigned int velmV = curveCode(CURVE_VELOCITY, velocity, 8191);
+      pwmWrite(VELOCITY1, velmV);
       switch (keyboardMode) {
         case 4:
           commandTopNote();
@@ -1267,66 +1667,66 @@ void myNoteOn(byte channel, byte note, byte velocity) {
         notes[noteMsg] = true;
       }
 
-      unsigned int velmV = map(velocity, 0, 127, 0, 8191);
+      unsigned int velmV = curveCode(CURVE_VELOCITY, velocity, 8191);
       switch (polycount) {
         case 1:
-          analogWrite(VELOCITY1, velmV);
+          pwmWrite(VELOCITY1, velmV);
           break;
 
         case 2:
-          analogWrite(VELOCITY1, velmV);
-          analogWrite(VELOCITY2, velmV);
+          pwmWrite(VELOCITY1, velmV);
+          pwmWrite(VELOCITY2, velmV);
           break;
 
         case 3:
-          analogWrite(VELOCITY1, velmV);
-          analogWrite(VELOCITY2, velmV);
-          analogWrite(VELOCITY3, velmV);
+          pwmWrite(VELOCITY1, velmV);
+          pwmWrite(VELOCITY2, velmV);
+          pwmWrite(VELOCITY3, velmV);
           break;
 
         case 4:
-          analogWrite(VELOCITY1, velmV);
-          analogWrite(VELOCITY2, velmV);
-          analogWrite(VELOCITY3, velmV);
-          analogWrite(VELOCITY4, velmV);
+          pwmWrite(VELOCITY1, velmV);
+          pwmWrite(VELOCITY2, velmV);
+          pwmWrite(VELOCITY3, velmV);
+          pwmWrite(VELOCITY4, velmV);
           break;
 
         case 5:
-          analogWrite(VELOCITY1, velmV);
-          analogWrite(VELOCITY2, velmV);
-          analogWrite(VELOCITY3, velmV);
-          analogWrite(VELOCITY4, velmV);
-          analogWrite(VELOCITY5, velmV);
+          pwmWrite(VELOCITY1, velmV);
+          pwmWrite(VELOCITY2, velmV);
+          pwmWrite(VELOCITY3, velmV);
+          pwmWrite(VELOCITY4, velmV);
+          pwmWrite(VELOCITY5, velmV);
           break;
 
         case 6:
-          analogWrite(VELOCITY1, velmV);
-          analogWrite(VELOCITY2, velmV);
-          analogWrite(VELOCITY3, velmV);
-          analogWrite(VELOCITY4, velmV);
-          analogWrite(VELOCITY5, velmV);
-          analogWrite(VELOCITY6, velmV);
+          pwmWrite(VELOCITY1, velmV);
+          pwmWrite(VELOCITY2, velmV);
+          pwmWrite(VELOCITY3, velmV);
+          pwmWrite(VELOCITY4, velmV);
+          pwmWrite(VELOCITY5, velmV);
+          pwmWrite(VELOCITY6, velmV);
           break;
 
         case 7:
-          analogWrite(VELOCITY1, velmV);
-          analogWrite(VELOCITY2, velmV);
-          analogWrite(VELOCITY3, velmV);
-          analogWrite(VELOCITY4, velmV);
-          analogWrite(VELOCITY5, velmV);
-          analogWrite(VELOCITY6, velmV);
-          analogWrite(VELOCITY7, velmV);
+          pwmWrite(VELOCITY1, velmV);
+          pwmWrite(VELOCITY2, velmV);
+          pwmWrite(VELOCITY3, velmV);
+          pwmWrite(VELOCITY4, velmV);
+          pwmWrite(VELOCITY5, velmV);
+          pwmWrite(VELOCITY6, velmV);
+          pwmWrite(VELOCITY7, velmV);
           break;
 
         case 8:
-          analogWrite(VELOCITY1, velmV);
-          analogWrite(VELOCITY2, velmV);
-          analogWrite(VELOCITY3, velmV);
-          analogWrite(VELOCITY4, velmV);
-          analogWrite(VELOCITY5, velmV);
-          analogWrite(VELOCITY6, velmV);
-          analogWrite(VELOCITY7, velmV);
-          analogWrite(VELOCITY8, velmV);
+          pwmWrite(VELOCITY1, velmV);
+          pwmWrite(VELOCITY2, velmV);
+          pwmWrite(VELOCITY3, velmV);
+          pwmWrite(VELOCITY4, velmV);
+          pwmWrite(VELOCITY5, velmV);
+          pwmWrite(VELOCITY6, velmV);
+          pwmWrite(VELOCITY7, velmV);
+          pwmWrite(VELOCITY8, velmV);
           break;
       }
       switch (keyboardMode) {
@@ -1345,69 +1745,25 @@ void myNoteOn(byte channel, byte note, byte velocity) {
           break;
       }
     }
+    noteRetrigger = false;
   }
   if (channel == gateChannel) {
-    for (uint8_t pin_index = polycount; pin_index < 8; pin_index++) {
-      if (GATE_NOTES[pin_index] == note) {
-        sr.set(pin_index, HIGH);
-        sr.set((pin_index + 16), HIGH);
-      }
-    }
+    trigNoteOn(note, velocity);
+    genNote(note, true);
   }
 }
 
 void myNoteOff(byte channel, byte note, byte velocity) {
+  ProfileScope profile(PROF_NOTE_OFF);
+  if (mpeNoteOff(channel, note)) return;
+  if (seqNoteOff(channel, note)) return;
   if (channel == midiChannel) {
     if (keyboardMode == 0) {
-      switch (getVoiceNo(note)) {
-        case 1:
-          sr.set(GATE_NOTE1, LOW);
-          sr.set(NOTE1_LED, LOW);
-          voices[0].note = -1;
-          voiceOn[0] = false;
-          break;
-        case 2:
-          sr.set(GATE_NOTE2, LOW);
-          sr.set(NOTE2_LED, LOW);
-          voices[1].note = -1;
-          voiceOn[1] = false;
-          break;
-        case 3:
-          sr.set(GATE_NOTE3, LOW);
-          sr.set(NOTE3_LED, LOW);
-          voices[2].note = -1;
-          voiceOn[2] = false;
-          break;
-        case 4:
-          sr.set(GATE_NOTE4, LOW);
-          sr.set(NOTE4_LED, LOW);
-          voices[3].note = -1;
-          voiceOn[3] = false;
-          break;
-        case 5:
-          sr.set(GATE_NOTE5, LOW);
-          sr.set(NOTE5_LED, LOW);
-          voices[4].note = -1;
-          voiceOn[4] = false;
-          break;
-        case 6:
-          sr.set(GATE_NOTE6, LOW);
-          sr.set(NOTE6_LED, LOW);
-          voices[5].note = -1;
-          voiceOn[5] = false;
-          break;
-        case 7:
-          sr.set(GATE_NOTE7, LOW);
-          sr.set(NOTE7_LED, LOW);
-          voices[6].note = -1;
-          voiceOn[6] = false;
-          break;
-        case 8:
-          sr.set(GATE_NOTE8, LOW);
-          sr.set(NOTE8_LED, LOW);
-          voices[7].note = -1;
-          voiceOn[7] = false;
-          break;
+      if (chainMode == CHAIN_LEADER && chainUnits > 1) {
+        chainNoteOff(note);
+      } else if (chainMode < CHAIN_FOLLOWER1) {
+        int voice = getVoiceNo(note);
+        if (voice >= 0 && !pedalHold(voice)) voiceNoteOff(voice);
       }
     } else if (keyboardMode == 4 || keyboardMode == 5 || keyboardMode == 6) {
 
@@ -1421,8 +1777,8 @@ void myNoteOff(byte channel, byte note, byte velocity) {
 
       // Pins NP_SEL1 and NP_SEL2 indictate note priority
 
-      unsigned int velmV = map(velocity, 0, 127, 0, 8191);
-      analogWrite(VELOCITY1, velmV);
+      unsigned int velmV = curveCode(CURVE_VELOCITY, velocity, 8191);
+      pwmWrite(VELOCITY1, velmV);
       switch (keyboardMode) {
         case 4:
           commandTopNote();
@@ -1447,66 +1803,66 @@ void myNoteOff(byte channel, byte note, byte velocity) {
         notes[noteMsg] = true;
       }
 
-      unsigned int velmV = map(velocity, 0, 127, 0, 8191);
+      unsigned int velmV = curveCode(CURVE_VELOCITY, velocity, 8191);
       switch (polycount) {
         case 1:
-          analogWrite(VELOCITY1, velmV);
+          pwmWrite(VELOCITY1, velmV);
           break;
 
         case 2:
-          analogWrite(VELOCITY1, velmV);
-          analogWrite(VELOCITY2, velmV);
+          pwmWrite(VELOCITY1, velmV);
+          pwmWrite(VELOCITY2, velmV);
           break;
 
         case 3:
-          analogWrite(VELOCITY1, velmV);
-          analogWrite(VELOCITY2, velmV);
-          analogWrite(VELOCITY3, velmV);
+          pwmWrite(VELOCITY1, velmV);
+          pwmWrite(VELOCITY2, velmV);
+          pwmWrite(VELOCITY3, velmV);
           break;
 
         case 4:
-          analogWrite(VELOCITY1, velmV);
-          analogWrite(VELOCITY2, velmV);
-          analogWrite(VELOCITY3, velmV);
-          analogWrite(VELOCITY4, velmV);
+          pwmWrite(VELOCITY1, velmV);
+          pwmWrite(VELOCITY2, velmV);
+          pwmWrite(VELOCITY3, velmV);
+          pwmWrite(VELOCITY4, velmV);
           break;
 
         case 5:
-          analogWrite(VELOCITY1, velmV);
-          analogWrite(VELOCITY2, velmV);
-          analogWrite(VELOCITY3, velmV);
-          analogWrite(VELOCITY4, velmV);
-          analogWrite(VELOCITY5, velmV);
+          pwmWrite(VELOCITY1, velmV);
+          pwmWrite(VELOCITY2, velmV);
+          pwmWrite(VELOCITY3, velmV);
+          pwmWrite(VELOCITY4, velmV);
+          pwmWrite(VELOCITY5, velmV);
           break;
 
         case 6:
-          analogWrite(VELOCITY1, velmV);
-          analogWrite(VELOCITY2, velmV);
-          analogWrite(VELOCITY3, velmV);
-          analogWrite(VELOCITY4, velmV);
-          analogWrite(VELOCITY5, velmV);
-          analogWrite(VELOCITY6, velmV);
+          pwmWrite(VELOCITY1, velmV);
+          pwmWrite(VELOCITY2, velmV);
+          pwmWrite(VELOCITY3, velmV);
+          pwmWrite(VELOCITY4, velmV);
+          pwmWrite(VELOCITY5, velmV);
+          pwmWrite(VELOCITY6, velmV);
           break;
 
         case 7:
-          analogWrite(VELOCITY1, velmV);
-          analogWrite(VELOCITY2, velmV);
-          analogWrite(VELOCITY3, velmV);
-          analogWrite(VELOCITY4, velmV);
-          analogWrite(VELOCITY5, velmV);
-          analogWrite(VELOCITY6, velmV);
-          analogWrite(VELOCITY7, velmV);
+          pwmWrite(VELOCITY1, velmV);
+          pwmWrite(VELOCITY2, velmV);
+          pwmWrite(VELOCITY3, velmV);
+          pwmWrite(VELOCITY4, velmV);
+          pwmWrite(VELOCITY5, velmV);
+          pwmWrite(VELOCITY6, velmV);
+          pwmWrite(VELOCITY7, velmV);
           break;
 
         case 8:
-          analogWrite(VELOCITY1, velmV);
-          analogWrite(VELOCITY2, velmV);
-          analogWrite(VELOCITY3, velmV);
-          analogWrite(VELOCITY4, velmV);
-          analogWrite(VELOCITY5, velmV);
-          analogWrite(VELOCITY6, velmV);
-          analogWrite(VELOCITY7, velmV);
-          analogWrite(VELOCITY8, velmV);
+          pwmWrite(VELOCITY1, velmV);
+          pwmWrite(VELOCITY2, velmV);
+          pwmWrite(VELOCITY3, velmV);
+          pwmWrite(VELOCITY4, velmV);
+          pwmWrite(VELOCITY5, velmV);
+          pwmWrite(VELOCITY6, velmV);
+          pwmWrite(VELOCITY7, velmV);
+          pwmWrite(VELOCITY8, velmV);
           break;
       }
       switch (keyboardMode) {
@@ -1527,108 +1883,48 @@ void myNoteOff(byte channel, byte note, byte velocity) {
     }
   }
   if (channel == gateChannel) {
-    for (uint8_t pin_index = polycount; pin_index < 8; pin_index++) {
-      if (GATE_NOTES[pin_index] == note) {
-        sr.set(pin_index, LOW);
-        sr.set((pin_index + 16), LOW);
-      }
-    }
+    trigNoteOff(note);
+    genNote(note, false);
   }
 }
 
+// NoteOff() - Voice from 0 playing the note, -1 for a stray or stolen note.
+// Note ons get their voice from allocVoice()
 int getVoiceNo(int note) {
-  voiceToReturn = -1;       //Initialise to 'null'
-  earliestTime = millis();  //Initialise to now
-  if (note == -1) {
-    //NoteOn() - Get the oldest free voice (recent voices may be still on release stage)
-    for (int i = 0; i < polycount; i++) {
-      if (voices[i].note == -1) {
-        if (voices[i].timeOn < earliestTime) {
-          earliestTime = voices[i].timeOn;
-          voiceToReturn = i;
-        }
-      }
-    }
-    if (voiceToReturn == -1) {
-      //No free voices, need to steal oldest sounding voice
-      earliestTime = millis();  //Reinitialise
-      for (int i = 0; i < polycount; i++) {
-        if (voices[i].timeOn < earliestTime) {
-          earliestTime = voices[i].timeOn;
-          voiceToReturn = i;
-        }
-      }
-    }
-    return voiceToReturn + 1;
-  } else {
-    //NoteOff() - Get voice number from note
-    for (int i = 0; i < polycount; i++) {
-      if (voices[i].note == note) {
-        return i + 1;
-      }
-    }
-  }
-  //Shouldn't get here, return voice 1
-  return 1;
-}
-
-void updateVoice1() {
-  unsigned int mV = (unsigned int)((float)(voices[0].note + transpose + realoctave) * NOTE_SF * sfAdj[0] + 0.5);
-  analogWrite(NOTE1, mV);
-  unsigned int velmV = map(voices[0].velocity, 0, 127, 0, 8191);
-  analogWrite(VELOCITY1, velmV);
-}
-
-void updateVoice2() {
-  unsigned int mV = (unsigned int)((float)(voices[1].note + transpose + realoctave) * NOTE_SF * sfAdj[1] + 0.5);
-  analogWrite(NOTE2, mV);
-  unsigned int velmV = map(voices[1].velocity, 0, 127, 0, 8191);
-  analogWrite(VELOCITY2, velmV);
-}
-
-void updateVoice3() {
-  unsigned int mV = (unsigned int)((float)(voices[2].note + transpose + realoctave) * NOTE_SF * sfAdj[2] + 0.5);
-  analogWrite(NOTE3, mV);
-  unsigned int velmV = map(voices[2].velocity, 0, 127, 0, 8191);
-  analogWrite(VELOCITY3, velmV);
-}
-
-void updateVoice4() {
-  unsigned int mV = (unsigned int)((float)(voices[3].note + transpose + realoctave) * NOTE_SF * sfAdj[3] + 0.5);
-  analogWrite(NOTE4, mV);
-  unsigned int velmV = map(voices[3].velocity, 0, 127, 0, 8191);
-  analogWrite(VELOCITY4, velmV);
+  return noteVoice[note & 0x7F] - 1;
 }
 
-void updateVoice5() {
-  unsigned int mV = (unsigned int)((float)(voices[4].note + transpose + realoctave) * NOTE_SF * sfAdj[4] + 0.5);
-  analogWrite(NOTE5, mV);
-  unsigned int velmV = map(voices[4].velocity, 0, 127, 0, 8191);
-  analogWrite(VELOCITY5, velmV);
+void updateVoice(int voice) {
+  unsigned int mV = noteCodeFor(voice, voices[voice].note);
+  glideTo(voice, mV);
+  unsigned int velmV = curveCode(CURVE_VELOCITY, voices[voice].velocity, 8191);
+  velocityWrite(voice, velmV);
 }
 
-void updateVoice6() {
-  unsigned int mV = (unsigned int)((float)(voices[5].note + transpose + realoctave) * NOTE_SF * sfAdj[5] + 0.5);
-  analogWrite(NOTE6, mV);
-  unsigned int velmV = map(voices[5].velocity, 0, 127, 0, 8191);
-  analogWrite(VELOCITY6, velmV);
+void voiceNoteOn(int voice, byte note, byte velocity) {
+  pedalClear(voice);
+  if (voices[voice].note >= 0 && noteVoice[voices[voice].note] == voice + 1) noteVoice[voices[voice].note] = 0;
+  noteVoice[note] = voice + 1;
+  voices[voice].note = note;
+  voices[voice].velocity = velocity;
+  voices[voice].timeOn = millis();
+  updateVoice(voice);
+  gateOn(voice, false);
+  voiceOn[voice] = true;
 }
 
-void updateVoice7() {
-  unsigned int mV = (unsigned int)((float)(voices[6].note + transpose + realoctave) * NOTE_SF * sfAdj[6] + 0.5);
-  analogWrite(NOTE7, mV);
-  unsigned int velmV = map(voices[6].velocity, 0, 127, 0, 8191);
-  analogWrite(VELOCITY7, velmV);
+// Frees a voice without touching its gate
+void voiceRelease(int voice) {
+  if (voices[voice].note >= 0 && noteVoice[voices[voice].note] == voice + 1) noteVoice[voices[voice].note] = 0;
+  voices[voice].note = -1;
+  voiceOn[voice] = false;
 }
 
-void updateVoice8() {
-  unsigned int mV = (unsigned int)((float)(voices[7].note + transpose + realoctave) * NOTE_SF * sfAdj[7] + 0.5);
-  analogWrite(NOTE8, mV);
-  unsigned int velmV = map(voices[7].velocity, 0, 127, 0, 8191);
-  analogWrite(VELOCITY8, velmV);
+void voiceNoteOff(int voice) {
+  voiceRelease(voice);
+  gateOff(voice);
 }
 
-
 void updateUnisonCheck() {
   // if (digitalRead(UNISON_ON) == 1 && keyboardMode == 0)  //poly
   // {
@@ -1650,23 +1946,23 @@ void updateUnisonCheck() {
 }
 
 void allNotesOff() {
-  sr.set(GATE_NOTE1, LOW);
-  sr.set(GATE_NOTE2, LOW);
-  sr.set(GATE_NOTE3, LOW);
-  sr.set(GATE_NOTE4, LOW);
-  sr.set(GATE_NOTE5, LOW);
-  sr.set(GATE_NOTE6, LOW);
-  sr.set(GATE_NOTE7, LOW);
-  sr.set(GATE_NOTE8, LOW);
-
-  sr.set(NOTE1_LED, LOW);
-  sr.set(NOTE2_LED, LOW);
-  sr.set(NOTE3_LED, LOW);
-  sr.set(NOTE4_LED, LOW);
-  sr.set(NOTE5_LED, LOW);
-  sr.set(NOTE6_LED, LOW);
-  sr.set(NOTE7_LED, LOW);
-  sr.set(NOTE8_LED, LOW);
+  srSet(GATE_NOTE1, LOW);
+  srSet(GATE_NOTE2, LOW);
+  srSet(GATE_NOTE3, LOW);
+  srSet(GATE_NOTE4, LOW);
+  srSet(GATE_NOTE5, LOW);
+  srSet(GATE_NOTE6, LOW);
+  srSet(GATE_NOTE7, LOW);
+  srSet(GATE_NOTE8, LOW);
+
+  srSet(NOTE1_LED, LOW);
+  srSet(NOTE2_LED, LOW);
+  srSet(NOTE3_LED, LOW);
+  srSet(NOTE4_LED, LOW);
+  srSet(NOTE5_LED, LOW);
+  srSet(NOTE6_LED, LOW);
+  srSet(NOTE7_LED, LOW);
+  srSet(NOTE8_LED, LOW);
 
   voices[0].note = -1;
   voices[1].note = -1;
@@ -1685,74 +1981,110 @@ void allNotesOff() {
   voiceOn[5] = false;
   voiceOn[6] = false;
   voiceOn[7] = false;
+
+  memset(noteVoice, 0, sizeof(noteVoice));
+  chainAllNotesOff();
+  mpeReset();
+  seqReset();
+  pedalReset();
 }
 
-void setCurrentPatchData(String data[]) {
+void setCurrentPatchData(char data[][PATCH_FIELD_SIZE]) {
   patchName = data[0];
-  polycount = data[1].toInt();
-  channel1 = data[2].toInt();
-  channel2 = data[3].toInt();
-  channel3 = data[4].toInt();
-  channel4 = data[5].toInt();
-  channel5 = data[6].toInt();
-  channel6 = data[7].toInt();
-  channel7 = data[8].toInt();
-  channel8 = data[9].toInt();
-  channel9 = data[10].toInt();
-  channel10 = data[11].toInt();
-  channel10 = data[12].toInt();
-  channel12 = data[13].toInt();
-  channel13 = data[14].toInt();
-  channel14 = data[15].toInt();
-  channel15 = data[16].toInt();
-  channel16 = data[17].toInt();
-
-  gate1 = data[18].toInt();
-  gate2 = data[19].toInt();
-  gate3 = data[20].toInt();
-  gate4 = data[21].toInt();
-  gate5 = data[22].toInt();
-  gate6 = data[23].toInt();
-  gate7 = data[24].toInt();
-  gate8 = data[25].toInt();
-
-  keyboardMode = data[26].toInt();
-  transpose = data[27].toInt();
-  realoctave = data[28].toInt();
-
-  channel1_CC = data[29].toInt();
-  channel2_CC = data[30].toInt();
-  channel3_CC = data[31].toInt();
-  channel4_CC = data[32].toInt();
-  channel5_CC = data[33].toInt();
-  channel6_CC = data[34].toInt();
-  channel7_CC = data[35].toInt();
-  channel8_CC = data[36].toInt();
-  channel9_CC = data[37].toInt();
-  channel10_CC = data[38].toInt();
-  channel10_CC = data[39].toInt();
-  channel12_CC = data[40].toInt();
-  channel13_CC = data[41].toInt();
-  channel14_CC = data[42].toInt();
-  channel15_CC = data[43].toInt();
-  channel16_CC = data[44].toInt();
-
-  channel1_MIDI = data[45].toInt();
-  channel2_MIDI = data[46].toInt();
-  channel3_MIDI = data[47].toInt();
-  channel4_MIDI = data[48].toInt();
-  channel5_MIDI = data[49].toInt();
-  channel6_MIDI = data[50].toInt();
-  channel7_MIDI = data[51].toInt();
-  channel8_MIDI = data[52].toInt();
-  channel9_MIDI = data[53].toInt();
-  channel10_MIDI = data[54].toInt();
-  channel10_MIDI = data[55].toInt();
-  channel12_MIDI = data[56].toInt();
-  channel13_MIDI = data[57].toInt();
-  channel14_MIDI = data[58].toInt();
-  channel15_MIDI = data[59].toInt();
-  channel16_MIDI = data[60].toInt();
+  polycount = atoi(data[1]);
+  channel1 = atoi(data[2]);
+  channel2 = atoi(data[3]);
+  channel3 = atoi(data[4]);
+  channel4 = atoi(data[5]);
+  channel5 = atoi(data[6]);
+  channel6 = atoi(data[7]);
+  channel7 = atoi(data[8]);
+  channel8 = atoi(data[9]);
+  channel9 = atoi(data[10]);
+  channel10 = atoi(data[11]);
+  channel10 = atoi(data[12]);
+  channel12 = atoi(data[13]);
+  channel13 = atoi(data[14]);
+  channel14 = atoi(data[15]);
+  channel15 = atoi(data[16]);
+  channel16 = atoi(data[17]);
+
+  gate1 = atoi(data[18]);
+  gate2 = atoi(data[19]);
+  gate3 = atoi(data[20]);
+  gate4 = atoi(data[21]);
+  gate5 = atoi(data[22]);
+  gate6 = atoi(data[23]);
+  gate7 = atoi(data[24]);
+  gate8 = atoi(data[25]);
+
+  keyboardMode = atoi(data[26]);
+  transpose = atoi(data[27]);
+  realoctave = atoi(data[28]);
+
+  channel1_CC = atoi(data[29]);
+  channel2_CC = atoi(data[30]);
+  channel3_CC = atoi(data[31]);
+  channel4_CC = atoi(data[32]);
+  channel5_CC = atoi(data[33]);
+  channel6_CC = atoi(data[34]);
+  channel7_CC = atoi(data[35]);
+  channel8_CC = atoi(data[36]);
+  channel9_CC = atoi(data[37]);
+  channel10_CC = atoi(data[38]);
+  channel10_CC = atoi(data[39]);
+  channel12_CC = atoi(data[40]);
+  channel13_CC = atoi(data[41]);
+  channel14_CC = atoi(data[42]);
+  channel15_CC = atoi(data[43]);
+  channel16_CC = atoi(data[44]);
+
+  channel1_MIDI = atoi(data[45]);
+  channel2_MIDI = atoi(data[46]);
+  channel3_MIDI = atoi(data[47]);
+  channel4_MIDI = atoi(data[48]);
+  channel5_MIDI = atoi(data[49]);
+  channel6_MIDI = atoi(data[50]);
+  channel7_MIDI = atoi(data[51]);
+  channel8_MIDI = atoi(data[52]);
+  channel9_MIDI = atoi(data[53]);
+  channel10_MIDI = atoi(data[54]);
+  channel10_MIDI = atoi(data[55]);
+  channel12_MIDI = atoi(data[56]);
+  channel13_MIDI = atoi(data[57]);
+  channel14_MIDI = atoi(data[58]);
+  channel15_MIDI = atoi(data[59]);
+  channel16_MIDI = atoi(data[60]);
+
+  glideMode = constrain(atoi(data[61]), 0, GLIDE_MODES - 1);
+  setGlideTime(atoi(data[62]));
+  setBendRange(atoi(data[PATCH_BEND_FIELD]));
+  polyAtMode = constrain(atoi(data[PATCH_POLYAT_FIELD]), POLY_AT_OFF, POLY_AT_MODES - 1);
+  setTuning(data[PATCH_TUNING_FIELD]);
+  quantParse(0, data[PATCH_QUANT_FIELD]);
+  quantParse(1, data[PATCH_QUANT_FIELD + 1]);
+
+  for (int r = 0; r < MOD_ROUTES; r++) {
+    modParse(r, data[PATCH_MOD_FIELD + r]);
+  }
+  modCompile();
+
+  for (int i = 0; i < CC_OUTPUTS; i++) {
+    hiresParse(i, data[PATCH_HIRES_FIELD + i]);
+    genParse(i, data[PATCH_GEN_FIELD + i]);
+  }
+  curveParse(data[PATCH_CURVE_FIELD]);
+  for (int part = 0; part < CURVE_FIELDS; part++) {
+    curveParseCustom(part, data[PATCH_CURVE_CUSTOM_FIELD + part]);
+  }
+  trigParse(data[PATCH_TRIG_FIELD]);
+  seqParse(data[PATCH_SEQ_FIELD]);
+  seqParseSteps(0, data[PATCH_SEQ_FIELD + 1]);
+  seqParseSteps(1, data[PATCH_SEQ_FIELD + 2]);
+  for (int g = 0; g < NO_OF_VOICES; g++) {
+    euclidParse(g, data[PATCH_EUCLID_FIELD + g]);
+  }
+  setAllocMode(atoi(data[PATCH_ALLOC_FIELD]));
 
   //MUX2
 
@@ -1816,26 +2148,63 @@ void setCurrentPatchData(String data[]) {
   updatePatchname();
 }
 
-String getCurrentPatchData() {
-  return patchName + "," + String(polycount) + "," + String(channel1) + "," + String(channel2) + "," + String(channel3) + "," + String(channel4)
-         + "," + String(channel5) + "," + String(channel6) + "," + String(channel7) + "," + String(channel8)
-         + "," + String(channel9) + "," + String(channel10) + "," + String(channel11) + "," + String(channel12)
-         + "," + String(channel13) + "," + String(channel14) + "," + String(channel15) + "," + String(channel16)
-         + "," + String(gate1) + "," + String(gate2) + "," + String(gate3) + "," + String(gate4)
-         + "," + String(gate5) + "," + String(gate6) + "," + String(gate7) + "," + String(gate8)
-         + "," + String(keyboardMode) + "," + String(transpose) + "," + String(realoctave)
-         + "," + String(channel1_CC) + "," + String(channel2_CC) + "," + String(channel3_CC) + "," + String(channel4_CC)
-         + "," + String(channel5_CC) + "," + String(channel6_CC) + "," + String(channel7_CC) + "," + String(channel8_CC)
-         + "," + String(channel9_CC) + "," + String(channel10_CC) + "," + String(channel11_CC) + "," + String(channel12_CC)
-         + "," + String(channel13_CC) + "," + String(channel14_CC) + "," + String(channel15_CC) + "," + String(channel16_CC)
-         + "," + String(channel1_MIDI) + "," + String(channel2_MIDI) + "," + String(channel3_MIDI) + "," + String(channel4_MIDI)
-         + "," + String(channel5_MIDI) + "," + String(channel6_MIDI) + "," + String(channel7_MIDI) + "," + String(channel8_MIDI)
-         + "," + String(channel9_MIDI) + "," + String(channel10_MIDI) + "," + String(channel11_MIDI) + "," + String(channel12_MIDI)
-         + "," + String(channel13_MIDI) + "," + String(channel14_MIDI) + "," + String(channel15_MIDI) + "," + String(channel16_MIDI);
+const char *getCurrentPatchData() {
+  snprintf(patchLine, PATCH_DATA_SIZE,
+           "%s,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d"
+           ",%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d"
+           ",%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d"
+           ",%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d"
+           ",%d,%d",
+           patchName.c_str(), polycount, channel1, channel2, channel3, channel4,
+           channel5, channel6, channel7, channel8,
+           channel9, channel10, channel11, channel12,
+           channel13, channel14, channel15, channel16,
+           gate1, gate2, gate3, gate4,
+           gate5, gate6, gate7, gate8,
+           keyboardMode, transpose, realoctave,
+           channel1_CC, channel2_CC, channel3_CC, channel4_CC,
+           channel5_CC, channel6_CC, channel7_CC, channel8_CC,
+           channel9_CC, channel10_CC, channel11_CC, channel12_CC,
+           channel13_CC, channel14_CC, channel15_CC, channel16_CC,
+           channel1_MIDI, channel2_MIDI, channel3_MIDI, channel4_MIDI,
+           channel5_MIDI, channel6_MIDI, channel7_MIDI, channel8_MIDI,
+           channel9_MIDI, channel10_MIDI, channel11_MIDI, channel12_MIDI,
+           channel13_MIDI, channel14_MIDI, channel15_MIDI, channel16_MIDI,
+           glideMode, glideTime);
+  for (int i = PATCH_FIXED_FIELDS; i < NO_OF_PARAMS; i++) {
+    strlcat(patchLine, ",", PATCH_DATA_SIZE);
+    strlcat(patchLine, getPatchField(i), PATCH_DATA_SIZE);
+  }
+  return patchLine;
+}
+
+const char *patchNumber(int number) {
+  static char field[8];
+  snprintf(field, sizeof(field), "%d", number);
+  return field;
+}
+
+//Fields after the fixed ones, empty if unused
+const char *getPatchField(int field) {
+  if (field == PATCH_BEND_FIELD) return patchNumber(bendRange);
+  if (field == PATCH_POLYAT_FIELD) return patchNumber(polyAtMode);
+  if (field == PATCH_TUNING_FIELD) return tuningName;
+  if (field == PATCH_QUANT_FIELD || field == PATCH_QUANT_FIELD + 1) return quantFormat(field - PATCH_QUANT_FIELD);
+  if (field >= PATCH_MOD_FIELD && field < PATCH_MOD_FIELD + MOD_ROUTES) return modFormat(field - PATCH_MOD_FIELD);
+  if (field >= PATCH_HIRES_FIELD && field < PATCH_HIRES_FIELD + CC_OUTPUTS) return hiresFormat(field - PATCH_HIRES_FIELD);
+  if (field >= PATCH_GEN_FIELD && field < PATCH_GEN_FIELD + CC_OUTPUTS) return genFormat(field - PATCH_GEN_FIELD);
+  if (field == PATCH_CURVE_FIELD) return curveFormat();
+  if (field == PATCH_TRIG_FIELD) return trigFormat();
+  if (field == PATCH_SEQ_FIELD) return seqFormat();
+  if (field == PATCH_SEQ_FIELD + 1 || field == PATCH_SEQ_FIELD + 2) return seqFormatSteps(field - PATCH_SEQ_FIELD - 1);
+  if (field >= PATCH_EUCLID_FIELD && field < PATCH_EUCLID_FIELD + NO_OF_VOICES) return euclidFormat(field - PATCH_EUCLID_FIELD);
+  if (field == PATCH_ALLOC_FIELD) return patchNumber(allocMode);
+  if (field >= PATCH_CURVE_CUSTOM_FIELD && field < PATCH_CURVE_CUSTOM_FIELD + CURVE_FIELDS) return curveFormatCustom(field - PATCH_CURVE_CUSTOM_FIELD);
+  return "";
 }
 
 void updatePatchname() {
-  showPatchPage(String(patchNo), patchName);
+  showPatchPage(patchNo, patchName.c_str());
 }
 
 void updateCCMAP() {
@@ -2011,6 +2380,7 @@ void updateCCMAP() {
       CC_MAP[15][2] = 1;
       break;
   }
+  invalidateOutputs();
 }
 
 void checkeepromChanges() {
@@ -2019,6 +2389,7 @@ void checkeepromChanges() {
     transpose = EEPROM.read(ADDR_TRANSPOSE);
     oldeepromtranspose = transpose;
     transpose = transpose - 12;
+    calBuildNotes();
   }
 
   if (oldeepromOctave != eepromOctave) {
@@ -2030,20 +2401,20 @@ void checkeepromChanges() {
     if (octave == 2) realoctave = 0;
     if (octave == 3) realoctave = 12;
     if (octave == 4) realoctave = 24;
+    calBuildNotes();
   }
 }
 
 
 void recallPatch(int patchNo) {
   allNotesOff();
-  File patchFile = SD.open(String(patchNo).c_str());
+  File patchFile = patchOpen(patchFileNameFor(patchNo));
   if (!patchFile) {
     Serial.println("File not found");
   } else {
-    String data[NO_OF_PARAMS];  //Array of data read in
-    recallPatchData(patchFile, data);
-    setCurrentPatchData(data);
-    patchFile.close();
+    recallPatchData(patchFile, patchFields);
+    setCurrentPatchData(patchFields);
+    patchClose(patchFile);
     storeLastPatch(patchNo);
   }
 }
@@ -2059,7 +2430,7 @@ void checkDrumEncoder() {
 
     if (!paramEdit && !paramChange) {
       param_number = param_number + 1;
-      if (param_number > 25) {
+      if (param_number > PARAM_PAGES) {
         param_number = 1;
       }
     }
@@ -2661,6 +3032,54 @@ void checkDrumEncoder() {
         }
         updategate8();
         break;
+
+      case 26:
+        if (paramEdit) {
+          setGlideTime(glideTimeStep(1));
+        }
+        updateGlideTime();
+        break;
+
+      case 27:
+        if (paramEdit) {
+          glideMode++;
+          if (glideMode >= GLIDE_MODES) {
+            glideMode = GLIDE_OFF;
+          }
+        }
+        updateGlideMode();
+        break;
+
+      case 28:
+        if (paramEdit) {
+          setBendRange(bendRange < BEND_RANGE_MAX ? bendRange + 1 : 0);
+        }
+        updateBendRange();
+        break;
+
+      case 29:
+        if (paramEdit) {
+          polyAtMode++;
+          if (polyAtMode >= POLY_AT_MODES) {
+            polyAtMode = POLY_AT_OFF;
+          }
+        }
+        updatePolyAtMode();
+        break;
+
+      case 30:
+        if (paramEdit) {
+          tuningStep(1);
+        }
+        updateTuning();
+        break;
+
+      case 31:
+        if (paramEdit) {
+          setAllocMode(allocMode < ALLOC_MODES - 1 ? allocMode + 1 : ALLOC_OLDEST);
+        }
+        updateAllocMode();
+        break;
     }
 
     param_encPrevious = param_encRead;
@@ -2670,7 +3089,7 @@ void checkDrumEncoder() {
     if (!paramEdit && !paramChange) {
       param_number = param_number - 1;
       if (param_number < 1) {
-        param_number = 25;
+        param_number = PARAM_PAGES;
       }
     }
     switch (param_number) {
@@ -3260,6 +3679,54 @@ void checkDrumEncoder() {
         }
         updategate8();
         break;
+
+      case 26:
+        if (paramEdit) {
+          setGlideTime(glideTimeStep(-1));
+        }
+        updateGlideTime();
+        break;
+
+      case 27:
+        if (paramEdit) {
+          glideMode--;
+          if (glideMode < GLIDE_OFF) {
+            glideMode = GLIDE_MODES - 1;
+          }
+        }
+        updateGlideMode();
+        break;
+
+      case 28:
+        if (paramEdit) {
+          setBendRange(bendRange > 0 ? bendRange - 1 : BEND_RANGE_MAX);
+        }
+        updateBendRange();
+        break;
+
+      case 29:
+        if (paramEdit) {
+          polyAtMode--;
+          if (polyAtMode < POLY_AT_OFF) {
+            polyAtMode = POLY_AT_MODES - 1;
+          }
+        }
+        updatePolyAtMode();
+        break;
+
+      case 30:
+        if (paramEdit) {
+          tuningStep(-1);
+        }
+        updateTuning();
+        break;
+
+      case 31:
+        if (paramEdit) {
+          setAllocMode(allocMode > ALLOC_OLDEST ? allocMode - 1 : ALLOC_MODES - 1);
+        }
+        updateAllocMode();
+        break;
     }
     param_encPrevious = param_encRead;
   }
@@ -3293,7 +3760,7 @@ void checkSwitches() {
       case PARAMETER:
         if (patches.size() < PATCHES_LIMIT) {
           resetPatchesOrdering();  //Reset order of patches from first patch
-          patches.push({ patches.size() + 1, INITPATCHNAME });
+          patches.push(patchEntry(patches.size() + 1, INITPATCHNAME));
           state = SAVE;
         }
         break;
@@ -3301,7 +3768,7 @@ void checkSwitches() {
         //Save as new patch with INITIALPATCH name or overwrite existing keeping name - bypassing patch renaming
         patchName = patches.last().patchName;
         state = PATCH;
-        savePatch(String(patches.last().patchNo).c_str(), getCurrentPatchData());
+        savePatch(patchFileNameFor(patches.last().patchNo), getCurrentPatchData());
         showPatchPage(patches.last().patchNo, patches.last().patchName);
         patchNo = patches.last().patchNo;
         loadPatches();  //Get rid of pushed patch if it wasn't saved
@@ -3312,8 +3779,8 @@ void checkSwitches() {
       case PATCHNAMING:
         if (renamedPatch.length() > 0) patchName = renamedPatch;  //Prevent empty strings
         state = PATCH;
-        savePatch(String(patches.last().patchNo).c_str(), getCurrentPatchData());
-        showPatchPage(patches.last().patchNo, patchName);
+        savePatch(patchFileNameFor(patches.last().patchNo), getCurrentPatchData());
+        showPatchPage(patches.last().patchNo, patchName.c_str());
         patchNo = patches.last().patchNo;
         loadPatches();  //Get rid of pushed patch if it wasn't saved
         setPatchesOrdering(patchNo);
@@ -3324,7 +3791,13 @@ void checkSwitches() {
   }
 
   settingsButton.update();
-  if (settingsButton.numClicks() == 1) {
+  if (settingsButton.held()) {
+    //Hidden timing stats page
+    if (state == PARAMETER) {
+      statsPage = 0;
+      state = STATS;
+    }
+  } else if (settingsButton.numClicks() == 1) {
     switch (state) {
       case PARAMETER:
         state = SETTINGS;
@@ -3372,6 +3845,9 @@ void checkSwitches() {
         state = SETTINGS;
         showSettingsPage();
         break;
+      case STATS:
+        state = PARAMETER;
+        break;
     }
   }
 
@@ -3404,10 +3880,10 @@ void checkSwitches() {
         break;
       case PATCHNAMING:
         if (renamedPatch.length() < 13) {
-          renamedPatch.concat(String(currentCharacter));
+          renamedPatch.concat(currentCharacter);
           charIndex = 0;
           currentCharacter = CHARACTERS[charIndex];
-          showRenamingPage(renamedPatch);
+          showRenamingPage(renamedPatch.c_str());
         }
         break;
       case DELETE:
@@ -3416,7 +3892,7 @@ void checkSwitches() {
           state = DELETEMSG;
           patchNo = patches.first().patchNo;     //PatchNo to delete from SD card
           patches.shift();                       //Remove patch from circular buffer
-          deletePatch(String(patchNo).c_str());  //Delete from SD card
+          deletePatch(patchFileNameFor(patchNo));  //Delete from SD card
           loadPatches();                         //Repopulate circular buffer to start from lowest Patch No
           renumberPatchesOnSD();
           loadPatches();                      //Repopulate circular buffer again after delete
@@ -3461,7 +3937,7 @@ void checkEncoder() {
       case PATCHNAMING:
         if (charIndex == TOTALCHARS) charIndex = 0;  //Wrap around
         currentCharacter = CHARACTERS[charIndex++];
-        showRenamingPage(renamedPatch + currentCharacter);
+        showRenamingPage(renamedPatch, currentCharacter);
         break;
       case DELETE:
         patches.push(patches.shift());
@@ -3474,6 +3950,9 @@ void checkEncoder() {
         settings::increment_setting_value();
         showSettingsPage();
         break;
+      case STATS:
+        statsPage = (statsPage + 1) % STATS_PAGES;
+        break;
     }
     encPrevious = encRead;
   } else if ((encCW && encRead < encPrevious - 3) || (!encCW && encRead > encPrevious + 3)) {
@@ -3495,7 +3974,7 @@ void checkEncoder() {
         if (charIndex == -1)
           charIndex = TOTALCHARS - 1;
         currentCharacter = CHARACTERS[charIndex--];
-        showRenamingPage(renamedPatch + currentCharacter);
+        showRenamingPage(renamedPatch, currentCharacter);
         break;
       case DELETE:
         patches.unshift(patches.pop());
@@ -3508,60 +3987,102 @@ void checkEncoder() {
         settings::decrement_setting_value();
         showSettingsPage();
         break;
+      case STATS:
+        statsPage = (statsPage + STATS_PAGES - 1) % STATS_PAGES;
+        break;
     }
     encPrevious = encRead;
   }
 }
 
 void loop() {
+  uint32_t loopStart = PROFILE_NOW();
+  uint32_t t = loopStart;
 
+  heapGuardSection = "switches";
   checkSwitches();
+  t = profileStage(PROF_SWITCHES, t);
+  heapGuardSection = "drum encoder";
   checkDrumEncoder();
+  t = profileStage(PROF_DRUM_ENCODER, t);
   checkeepromChanges();
+  heapGuardSection = "encoder";
+  t = PROFILE_NOW();
   checkEncoder();
+  t = profileStage(PROF_ENCODER, t);
+  heapGuardSection = "midi";
+  //MIDI dispatch and the outputs it writes are never preempted by the display thread
+  int threadState = threads.stop();
+  boolean midiActive = false;
+  profilePollGap();
   myusb.Task();
-  midi1.read(0);    //USB HOST MIDI Class Compliant
-  MIDI.read(0);     //MIDI 5 Pin DIN
-  usbMIDI.read(0);  //USB Client MIDI
+  t = profileStage(PROF_USB_TASK, t);
+  for (int n = 0; n < MIDI_BATCH && midi1.read(0); n++) {  //USB HOST MIDI Class Compliant
+    profileMessage(PORT_HOST);
+    midiActive = true;
+  }
+  t = profileStage(PROF_READ_HOST, t);
+  profileCheckDin();
+  for (int n = 0; n < MIDI_BATCH && MIDI.read(0); n++) {  //MIDI 5 Pin DIN
+    profileMessage(PORT_DIN);
+    midiActive = true;
+  }
+  t = profileStage(PROF_READ_DIN, t);
+  for (int n = 0; n < MIDI_BATCH && usbMIDI.read(0); n++) {  //USB Client MIDI
+    profileMessage(PORT_USB);
+    midiActive = true;
+  }
+  t = profileStage(PROF_READ_USB, t);
+  chainRead();  //Voice chain from the leader
+  t = PROFILE_NOW();
+  hiresService();
+  genService();
+  commitOutputs();
+  t = profileStage(PROF_COMMIT, t);
+  threads.start(threadState);
   ledsOff();
+  profileStage(PROF_LEDS_OFF, t);
+  heapGuardSection = "report";
+  heapGuardReport();
+  consoleRead();
+  masterService();
+  profileUpdateRates();
+  profileStage(PROF_LOOP, loopStart);
+  //Display and storage only get the CPU on passes with no MIDI waiting
+  if (!midiActive) threads.yield();
 }
 
 void ledsOff() {
 
-  if ((clock_timer > 0) && (millis() - clock_timer > 60)) {
-    sr.set(CLOCK_LED, LOW);
-    clock_timer = 0;
-  }
-
   if ((pitchbend_timer > 0) && (millis() - pitchbend_timer > 60)) {
-    sr.set(PITCHBEND_LED, LOW);
+    srSet(PITCHBEND_LED, LOW);
     pitchbend_timer = 0;
   }
 
   if ((mod_timer > 0) && (millis() - mod_timer > 60)) {
-    sr.set(MOD_LED, LOW);
+    srSet(MOD_LED, LOW);
     mod_timer = 0;
   }
 
   if ((aftertouch_timer > 0) && (millis() - aftertouch_timer > 60)) {
-    sr.set(AFTERTOUCH_LED, LOW);
+    srSet(AFTERTOUCH_LED, LOW);
     aftertouch_timer = 0;
   }
 
   if ((breath_timer > 0) && (millis() - breath_timer > 60)) {
-    sr.set(BREATH_LED, LOW);
+    srSet(BREATH_LED, LOW);
     breath_timer = 0;
   }
 
   if ((reset_timer > 0) && (millis() - reset_timer > 60)) {
-    sr.set(RESET, LOW);
+    srSet(RESET, LOW);
     reset_timer = 0;
   }
 
   for (int i = 0; i < 16; i++) {
-    if ((CC_MAP[i][2] == 0 && CC_MAP[i][4] == 2) || (CC_MAP[i][2] == 0 && CC_MAP[i][4] == 3) || (CC_MAP[i][2] == 0 && CC_MAP[i][4] == 4) || (CC_MAP[i][2] == 0 && CC_MAP[i][4] == 5)) {
+    if (CC_MAP[i][2] == 0 && CC_MAP[i][4] >= 2) {
       if ((outputLEDS[i] > 0) && (millis() - outputLEDS[i] > 60)) {
-        sr.set(CC_MAP[i][5], LOW);
+        srSet(CC_MAP[i][5], LOW);
         outputLEDS[i] = 0;
       }
     }
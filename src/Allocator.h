@@ -0,0 +1,214 @@
+/*
+  Voice allocator - strategies for picking a poly voice for a new note
+
+  Every strategy shares one core: a voice that last played the note (Same
+  Note only), else a free voice in the strategy's order, else a voice only a
+  pedal is holding, else a sounding voice stolen in the strategy's order.
+  Each step is a table lookup or one pass over the voices. A chain leader
+  allocates from the voices of the whole chain the same way, without the
+  pedal step as the pedals only hold the leader's own voices.
+
+    Oldest         the oldest free voice, steals the oldest note
+    Round Robin    the next free voice after the last one used, steals the next
+    Same Note      the voice that last played the note if it's free or
+                   playing it, otherwise Oldest
+    Steal Lowest   Oldest, steals the lowest note
+    Steal Highest  Oldest, steals the highest note
+    Reset          the lowest numbered free voice, so a chord starts from
+                   voice 1 for paraphonic patches, steals the oldest
+
+  Console: alloc shows the strategy and allocation time, alloc test [events]
+  replays a random note stream through each strategy on a copy of the voice
+  state, checks every allocation against the strategy's rules and prints
+  the time per allocation and any failures. The outputs aren't touched.
+*/
+
+#define ALLOC_OLDEST 0
+#define ALLOC_ROUND_ROBIN 1
+#define ALLOC_SAME_NOTE 2
+#define ALLOC_STEAL_LOWEST 3
+#define ALLOC_STEAL_HIGHEST 4
+#define ALLOC_RESET 5
+#define ALLOC_MODES 6
+#define ALLOC_TEST_EVENTS 2000
+#define ALLOC_TEST_EVENTS_MAX 100000
+
+const char *ALLOC_MODE_NAMES[ALLOC_MODES] = { "Oldest", "Round Robin", "Same Note", "Steal Lowest", "Steal Highest", "Reset" };
+
+int allocMode = ALLOC_OLDEST;  // Patch
+uint8_t allocNext = 0;         // Round robin position
+uint8_t allocLastVoice[128];   // Voice + 1 that last played each note
+
+int allocFree(const VoiceAndNote *set, int count) {
+  int found = -1;
+  for (int i = 0; i < count; i++) {
+    int voice = allocMode == ALLOC_ROUND_ROBIN ? (allocNext + i) % count : i;
+    if (set[voice].note != -1) continue;
+    if (allocMode == ALLOC_ROUND_ROBIN || allocMode == ALLOC_RESET) return voice;
+    if (found < 0 || set[voice].timeOn < set[found].timeOn) found = voice;
+  }
+  return found;
+}
+
+int allocSteal(const VoiceAndNote *set, int count) {
+  if (allocMode == ALLOC_ROUND_ROBIN) return allocNext % count;
+  int found = 0;
+  for (int voice = 1; voice < count; voice++) {
+    const VoiceAndNote &v = set[voice];
+    const VoiceAndNote &best = set[found];
+    boolean better;
+    switch (allocMode) {
+      case ALLOC_STEAL_LOWEST:
+        better = v.note < best.note;
+        break;
+      case ALLOC_STEAL_HIGHEST:
+        better = v.note > best.note;
+        break;
+      default:
+        better = v.timeOn < best.timeOn;
+        break;
+    }
+    if (better) found = voice;
+  }
+  return found;
+}
+
+// Voice from the set for a new note, the pedals only hold the poly voices
+int allocFrom(const VoiceAndNote *set, int count, int note) {
+  ProfileScope profile(PROF_ALLOC);
+  if (count == 0) return 0;
+  boolean pedals = set == voices;
+  int voice = -1;
+  if (allocMode == ALLOC_SAME_NOTE) {
+    int last = allocLastVoice[note & 0x7F] - 1;
+    if (last >= 0 && last < count && (set[last].note == -1 || set[last].note == note || (pedals && (pedalReleased & (1 << last))))) voice = last;
+  }
+  if (voice < 0) voice = allocFree(set, count);
+  if (voice < 0 && pedals) voice = pedalOldest();
+  if (voice < 0) voice = allocSteal(set, count);
+  allocNext = (voice + 1) % count;
+  allocLastVoice[note & 0x7F] = voice + 1;
+  return voice;
+}
+
+int allocVoice(int note) {
+  return allocFrom(voices, polycount, note);
+}
+
+void setAllocMode(int mode) {
+  allocMode = constrain(mode, ALLOC_OLDEST, ALLOC_MODES - 1);
+  allocNext = 0;
+  memset(allocLastVoice, 0, sizeof(allocLastVoice));
+}
+
+void updateAllocMode() {
+  showCurrentParameterPage("Voice Alloc", ALLOC_MODE_NAMES[allocMode]);
+}
+
+// Checks one allocation against the strategy, with the voices and the note's
+// last voice as they were before it
+boolean allocCheck(int note, int voice, int next, int last, const VoiceAndNote *before) {
+  if (voice < 0 || voice >= polycount) return false;
+  int freeCount = 0, oldestFree = -1, lowestFree = -1;
+  for (int i = 0; i < polycount; i++) {
+    if (before[i].note != -1) continue;
+    freeCount++;
+    if (lowestFree < 0) lowestFree = i;
+    if (oldestFree < 0 || before[i].timeOn < before[oldestFree].timeOn) oldestFree = i;
+  }
+  if (allocMode == ALLOC_SAME_NOTE && last >= 0 && last < polycount && (before[last].note == -1 || before[last].note == note)) {
+    return voice == last;
+  }
+  if (freeCount) {
+    if (before[voice].note != -1) return false;  // Stole with a voice free
+    if (allocMode == ALLOC_RESET) return voice == lowestFree;
+    if (allocMode == ALLOC_ROUND_ROBIN) {
+      for (int i = next; i != voice; i = (i + 1) % polycount) {
+        if (before[i].note == -1) return false;  // Skipped a free voice
+      }
+      return true;
+    }
+    return before[voice].timeOn == before[oldestFree].timeOn;  // Oldest, Same Note and the steal modes
+  }
+  for (int i = 0; i < polycount; i++) {
+    if (allocMode == ALLOC_STEAL_LOWEST && before[i].note < before[voice].note) return false;
+    if (allocMode == ALLOC_STEAL_HIGHEST && before[i].note > before[voice].note) return false;
+    if ((allocMode == ALLOC_OLDEST || allocMode == ALLOC_SAME_NOTE || allocMode == ALLOC_RESET) && before[i].timeOn < before[voice].timeOn) return false;
+  }
+  return allocMode != ALLOC_ROUND_ROBIN || voice == next;
+}
+
+void allocTest(int events) {
+  VoiceAndNote saved[NO_OF_VOICES];
+  uint8_t savedLast[128];
+  memcpy(saved, voices, sizeof(saved));
+  memcpy(savedLast, allocLastVoice, sizeof(savedLast));
+  int savedMode = allocMode;
+  uint8_t savedNext = allocNext;
+  uint8_t savedReleased = pedalReleased;
+  pedalReleased = 0;
+  for (int mode = 0; mode < ALLOC_MODES; mode++) {
+    setAllocMode(mode);
+    for (int i = 0; i < NO_OF_VOICES; i++) voices[i] = { -1, -1, 0 };
+    uint32_t random = 12345 + mode;
+    long clock = 1;
+    uint32_t ticks = 0, allocations = 0, failures = 0;
+    for (int n = 0; n < events; n++) {
+      random = random * 1664525 + 1013904223;
+      int held = 0;
+      for (int i = 0; i < polycount; i++) held += voices[i].note != -1;
+      if (held && (random >> 24) < 96) {  // Note off for a sounding voice
+        int voice = (random >> 8) % polycount;
+        while (voices[voice].note == -1) voice = (voice + 1) % polycount;
+        voices[voice].note = -1;
+        continue;
+      }
+      int note = 36 + (random >> 16) % 49;
+      VoiceAndNote before[NO_OF_VOICES];
+      memcpy(before, voices, sizeof(before));
+      int next = allocNext;
+      int last = allocLastVoice[note] - 1;
+      uint32_t start = PROFILE_NOW();
+      int voice = allocVoice(note);
+      ticks += PROFILE_NOW() - start;
+      allocations++;
+      if (!allocCheck(note, voice, next, last, before)) failures++;
+      if (voice >= 0 && voice < polycount) voices[voice] = { note, 100, clock++ };
+    }
+    Serial.print(ALLOC_MODE_NAMES[mode]);
+    Serial.print(" allocations ");
+    Serial.print(allocations);
+    Serial.print(" us each ");
+    Serial.print(allocations ? (float)ticks / PROFILE_TICKS_PER_US / allocations : 0, 3);
+    Serial.print(" failures ");
+    Serial.println(failures);
+  }
+  memcpy(voices, saved, sizeof(saved));
+  memcpy(allocLastVoice, savedLast, sizeof(savedLast));
+  allocMode = savedMode;
+  allocNext = savedNext;
+  pedalReleased = savedReleased;
+}
+
+void allocCommand(const char *args) {
+  if (strncmp(args, "test", 4) == 0) {
+    if (polycount == 0) {
+      Serial.println("alloc test needs a poly count");
+      return;
+    }
+    int events = atoi(args + 4);
+    allocTest(events > 0 ? min(events, ALLOC_TEST_EVENTS_MAX) : ALLOC_TEST_EVENTS);
+    return;
+  }
+  Serial.print("alloc ");
+  Serial.print(ALLOC_MODE_NAMES[allocMode]);
+  Serial.print(" avg us ");
+  Serial.print(profileAverageUs(PROF_ALLOC), 2);
+  Serial.print(" max us ");
+  Serial.println(profileMaxUs(PROF_ALLOC), 2);
+}
+
+void setupAllocator() {
+  setAllocMode(ALLOC_OLDEST);
+  consoleAppend("alloc", "voice allocation time, alloc test [events] checks each strategy", allocCommand);
+}
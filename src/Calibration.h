@@ -0,0 +1,194 @@
+/*
+  Calibration - per volt correction points for all 20 PWM outputs
+
+  Each output has a correction in DAC codes at every volt from 0V to 10V.
+  Between points the correction is interpolated, from a per segment slope
+  worked out when the table loads, so correcting a code is a divide, a
+  multiply and a shift. The note CVs don't even pay that: every voice has a
+  128 entry table of calibrated codes, with the tuning, transpose, octave
+  and its SF Adjust scale folded in, rebuilt only when one of those changes.
+
+  The table is kept in EEPROM with a CRC. If the CRC doesn't match, the
+  outputs run uncorrected.
+
+  Calibrating an output:
+    cal <output 1-20> <volt 0-10>   outputs that point uncorrected to measure
+    cal <output 1-20> csv v0,v1,... fits the voltages measured at each point
+    cal <output 1-20> clear         removes the output's corrections
+  Outputs 1-8 are the note CVs, 9-16 the velocity CVs, then pitch bend, mod
+  wheel, aftertouch and breath. A partial CSV fits the points given and
+  leaves the rest. cal on its own lists the table.
+*/
+
+#define CAL_OUTPUTS 20
+#define CAL_POINTS 11           // 0V to 10V
+#define CAL_SEGMENT_CODES 1554  // One volt, 12 * NOTE_SF
+#define CAL_DELTA_MAX 2000
+#define CAL_PIN_SLOTS 64
+#define CAL_NONE 0xFF
+#define PWM_MAX 16383
+
+const uint8_t CAL_PINS[CAL_OUTPUTS] = { NOTE1, NOTE2, NOTE3, NOTE4, NOTE5, NOTE6, NOTE7, NOTE8,
+                                        VELOCITY1, VELOCITY2, VELOCITY3, VELOCITY4, VELOCITY5, VELOCITY6, VELOCITY7, VELOCITY8,
+                                        PITCHBEND, WHEEL, AFTERTOUCH, BREATH };
+
+struct CalTable {
+  int16_t delta[CAL_OUTPUTS][CAL_POINTS];  // Codes added at each volt
+  uint16_t crc;
+};
+
+CalTable calTable;
+int32_t calSlope[CAL_OUTPUTS][CAL_POINTS - 1];  // 16.16 change in correction per code
+uint8_t calOutputOfPin[CAL_PIN_SLOTS];
+uint16_t noteCode[NO_OF_VOICES][128];          // Calibrated pitch code for each note
+float tuningSemis[128];                        // Pitch of each note in semitones, set by the tuning
+
+uint16_t calCrc(const uint8_t *data, size_t length) {
+  uint16_t crc = 0xFFFF;
+  while (length--) {
+    crc ^= *data++ << 8;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+inline uint16_t calApply(int out, int32_t code) {
+  code = constrain(code, (int32_t)0, (int32_t)PWM_MAX);
+  int k = min((int)(code / CAL_SEGMENT_CODES), CAL_POINTS - 2);
+  int32_t within = code - k * CAL_SEGMENT_CODES;
+  int32_t corrected = code + calTable.delta[out][k] + ((within * calSlope[out][k]) >> 16);
+  return constrain(corrected, (int32_t)0, (int32_t)PWM_MAX);
+}
+
+// analogWrite for the CV outputs, through the output's calibration
+inline void pwmWrite(uint8_t pin, uint16_t code) {
+  uint8_t out = pin < CAL_PIN_SLOTS ? calOutputOfPin[pin] : CAL_NONE;
+  analogWrite(pin, out == CAL_NONE ? code : calApply(out, code));
+}
+
+// Pitch code for a note on a voice
+inline uint16_t noteCodeFor(int voice, int note) {
+  return noteCode[voice][note & 0x7F];
+}
+
+void calBuildNotes() {
+  for (int voice = 0; voice < NO_OF_VOICES; voice++) {
+    float scale = NOTE_SF * sfAdj[voice];
+    for (int note = 0; note < 128; note++) {
+      float semis = tuningSemis[constrain(note + transpose + realoctave, 0, 127)];
+      noteCode[voice][note] = calApply(voice, (int32_t)(semis * scale + 0.5f));
+    }
+  }
+}
+
+void calBuild() {
+  for (int out = 0; out < CAL_OUTPUTS; out++) {
+    for (int k = 0; k < CAL_POINTS - 1; k++) {
+      calSlope[out][k] = ((int32_t)(calTable.delta[out][k + 1] - calTable.delta[out][k]) << 16) / CAL_SEGMENT_CODES;
+    }
+  }
+  calBuildNotes();
+}
+
+void calSave() {
+  calTable.crc = calCrc((const uint8_t *)calTable.delta, sizeof(calTable.delta));
+  storeCalibration((const uint8_t *)&calTable, sizeof(calTable));
+  calBuild();
+}
+
+void calLoad() {
+  getCalibration((uint8_t *)&calTable, sizeof(calTable));
+  if (calTable.crc != calCrc((const uint8_t *)calTable.delta, sizeof(calTable.delta))) {
+    memset(&calTable, 0, sizeof(calTable));
+  }
+  calBuild();
+}
+
+void setSFAdjust(int voice, int step) {
+  sfAdj[voice] = 1.0f + step * SF_ADJ_STEP;
+  storeSFAdjust(voice, sfAdj[voice]);
+  calBuildNotes();
+}
+
+// Fits corrections from the voltages measured with each point output uncorrected.
+// The code that gives exactly k volts is found between the measurements either side.
+void calFit(int out, const float *measured, int count) {
+  int16_t delta[CAL_POINTS];
+  for (int k = 0; k < count; k++) {
+    int j = 0;
+    while (j < count - 2 && measured[j + 1] < k) j++;
+    float span = measured[j + 1] - measured[j];
+    if (span <= 0) {
+      Serial.println("cal measurements must rise with each volt");
+      return;
+    }
+    float code = (j + (k - measured[j]) / span) * CAL_SEGMENT_CODES;
+    delta[k] = constrain((int)roundf(code - k * CAL_SEGMENT_CODES), -CAL_DELTA_MAX, CAL_DELTA_MAX);
+  }
+  memcpy(calTable.delta[out], delta, count * sizeof(delta[0]));
+  calSave();
+}
+
+void calPrint(int out) {
+  Serial.print("out");
+  Serial.print(out + 1);
+  for (int k = 0; k < CAL_POINTS; k++) {
+    Serial.print(k ? "," : " ");
+    Serial.print(calTable.delta[out][k]);
+  }
+  Serial.println();
+}
+
+void calCommand(const char *args) {
+  int output = 0;
+  int consumed = 0;
+  if (sscanf(args, "%d %n", &output, &consumed) < 1 || output < 1 || output > CAL_OUTPUTS) {
+    for (int out = 0; out < CAL_OUTPUTS; out++) calPrint(out);
+    return;
+  }
+  int out = output - 1;
+  const char *rest = args + consumed;
+  if (strncmp(rest, "csv", 3) == 0) {
+    float measured[CAL_POINTS];
+    int count = 0;
+    char *end;
+    const char *p = rest + 3;
+    while (count < CAL_POINTS) {
+      measured[count] = strtof(p, &end);
+      if (end == p) break;
+      count++;
+      p = end;
+      while (*p == ',' || *p == ' ') p++;
+    }
+    if (count < 2) {
+      Serial.println("cal <output> csv needs at least the 0V and 1V measurements");
+      return;
+    }
+    calFit(out, measured, count);
+  } else if (strncmp(rest, "clear", 5) == 0) {
+    memset(calTable.delta[out], 0, sizeof(calTable.delta[out]));
+    calSave();
+  } else {
+    int volt = constrain(atoi(rest), 0, CAL_POINTS - 1);
+    analogWrite(CAL_PINS[out], min(volt * CAL_SEGMENT_CODES, PWM_MAX));
+  }
+  calPrint(out);
+}
+
+void setupCalibration() {
+  memset(calOutputOfPin, CAL_NONE, sizeof(calOutputOfPin));
+  for (int note = 0; note < 128; note++) {
+    tuningSemis[note] = note;
+  }
+  for (int out = 0; out < CAL_OUTPUTS; out++) {
+    calOutputOfPin[CAL_PINS[out]] = out;
+  }
+  for (int voice = 0; voice < NO_OF_VOICES; voice++) {
+    sfAdj[voice] = getSFAdjust(voice);
+  }
+  calLoad();
+  pwmWrite(PITCHBEND, 1543);
+  consoleAppend("cal", "cal <output> <volt|csv v0,v1,...|clear> - output calibration", calCommand);
+}
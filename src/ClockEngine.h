@@ -0,0 +1,345 @@
+/*
+  Clock engine - divided, multiplied and swung clocks from MIDI clock
+
+  The time between MIDI clock ticks is tracked by a simple PLL: the period
+  estimate moves a fraction of the error on every tick, a large fraction until
+  it is locked and a small one after. Each incoming tick resets the phase, and
+  the ticks in between are split into CLOCK_SUBTICKS sub ticks by a timer
+  running at the estimated period, which gives up to 96 PPQN out.
+
+  Positions are counted in sub ticks from Start. A clock output pulses when the
+  position is a multiple of its rate. Swung rates push every second pulse
+  late by the swing amount. Pulses are scheduled on the gate scheduler with
+  the Clock Width setting, capped at half the pulse interval so fast tempos
+  can't run pulses together.
+
+  The main clock output divides the quarter note by Clock Div. Free gates set
+  past the last gate note in the patch become clock outputs. The arpeggiator
+  and sequencer in Sequencer.h and the pattern gates in Euclid.h step from
+  here too.
+
+  Internal clock: with Clock Source set to Internal a second timer generates
+  the ticks at the Tempo setting. Its interrupt drives the outputs directly,
+  so the display and SD card can't delay them. The DIN and USB clock bytes
+  are queued and sent from loop(), as loop() also writes to Serial1 for
+  Start, Stop and MIDI thru. As soon as a clock arrives
+  at myClock() the external clock takes over, and the internal clock resumes
+  once the external one has been gone for CLOCK_TIMEOUT_US.
+*/
+
+#define CLOCK_SUBTICKS 4
+#define CLOCK_QUARTER (24 * CLOCK_SUBTICKS)
+#define CLOCK_TIMEOUT_US 300000    // A longer gap than this tracks the tempo again
+#define CLOCK_PLL_FAST_GAIN 0.25f  // Fraction of the period error taken until locked
+#define CLOCK_PLL_GAIN 0.0625f     // and once locked
+#define CLOCK_LOCK_TOLERANCE 0.02f // Ticks within 2% of the period count towards lock
+#define CLOCK_UNLOCK_TOLERANCE 0.1f
+#define CLOCK_LOCK_TICKS 24
+#define CLOCK_EXTERNAL 0
+#define CLOCK_INTERNAL 1
+
+struct ClockRate {
+  const char *name;
+  uint16_t subticks;
+  boolean swing;
+};
+
+const ClockRate CLOCK_RATES[GATE_CLOCK_MODES] = {
+  { "Clock 1/2", CLOCK_QUARTER * 2, false },
+  { "Clock 1/4", CLOCK_QUARTER, false },
+  { "Clock 1/8", CLOCK_QUARTER / 2, false },
+  { "Clock 1/16", CLOCK_QUARTER / 4, false },
+  { "Clock 1/32", CLOCK_QUARTER / 8, false },
+  { "Clock 1/8T", CLOCK_QUARTER / 3, false },
+  { "Clock 1/16T", CLOCK_QUARTER / 6, false },
+  { "Swing 1/8", CLOCK_QUARTER / 2, true },
+  { "Swing 1/16", CLOCK_QUARTER / 4, true },
+  { "24 PPQN", CLOCK_SUBTICKS, false },
+  { "48 PPQN", CLOCK_SUBTICKS / 2, false },
+  { "96 PPQN", 1, false },
+};
+
+// Step lengths for the sequencer and the pattern gates
+#define STEP_RATES 6
+const char *STEP_RATE_NAMES[STEP_RATES] = { "1/4", "1/8", "1/16", "1/32", "1/8T", "1/16T" };
+const uint16_t STEP_RATE_SUBTICKS[STEP_RATES] = { CLOCK_QUARTER, CLOCK_QUARTER / 2, CLOCK_QUARTER / 4, CLOCK_QUARTER / 8,
+                                                  CLOCK_QUARTER / 3, CLOCK_QUARTER / 6 };
+
+IntervalTimer clockTimer;
+
+volatile uint32_t clockPosition = 0;  // Sub ticks since Start
+volatile uint8_t clockSubtick = 0;
+volatile boolean clockRunning = true;
+float clockPeriod = 0;  // us between MIDI clock ticks, 0 until known
+uint32_t clockLastTick = 0;
+uint32_t clockLockStart = 0;
+int clockStable = 0;
+boolean clockLocked = false;
+
+int clockDiv = 1;       // Main clock output, quarter notes per pulse (EEPROM)
+int clockWidth = 10;    // Pulse width in ms (EEPROM)
+int clockSwing = 50;    // Swing in %, 50 is straight (EEPROM)
+
+IntervalTimer masterTimer;
+
+int clockSource = CLOCK_EXTERNAL;  // (EEPROM)
+int masterTempo = 120;             // BPM of the internal clock (EEPROM)
+float masterPeriod = 0;            // us per tick at masterTempo
+volatile boolean masterActive = false;  // Internal clock timer running
+boolean masterPlaying = false;
+volatile uint8_t clockBytesPending = 0;  // Clock bytes for loop() to send
+uint32_t masterLastTick = 0;
+uint32_t externalClockTime = 0;
+
+void myStart();
+void myStop();
+void seqClock(uint32_t position);
+void euclidClock(uint32_t position);
+extern uint8_t euclidGates;
+
+// Pulse every output whose rate falls on this sub tick
+void clockOutputs(uint32_t position) {
+  uint32_t subtickUs = clockPeriod / CLOCK_SUBTICKS;
+  uint32_t rate = CLOCK_QUARTER * clockDiv;
+  if (position % rate == 0) {
+    uint32_t width = clockWidth * 1000;
+    if (subtickUs) width = min(width, rate * subtickUs / 2);
+    gateSchedule(CLOCK_LED, HIGH, 0, width);
+  }
+  for (uint8_t pin_index = polycount; pin_index < 8; pin_index++) {
+    if (GATE_NOTES[pin_index] <= GATE_NOTE_MAX || (euclidGates & (1 << pin_index))) continue;
+    const ClockRate &clock = CLOCK_RATES[GATE_NOTES[pin_index] - GATE_NOTE_MAX - 1];
+    if (position % clock.subticks) continue;
+    uint32_t width = clockWidth * 1000;
+    if (subtickUs) width = min(width, clock.subticks * subtickUs / 2);
+    uint32_t delay = 0;
+    if (clock.swing && ((position / clock.subticks) & 1)) {
+      delay = (clockSwing - 50) * clock.subticks * subtickUs / 50;
+    }
+    gateSchedule(pin_index, HIGH, delay, width);
+  }
+  euclidClock(position);
+  seqClock(position);
+}
+
+void clockTimerIsr() {
+  clockSubtick++;
+  if (clockRunning) clockOutputs(clockPosition++);
+  if (clockSubtick >= CLOCK_SUBTICKS - 1) clockTimer.end();  // Wait for the next tick
+}
+
+void clockTrack(uint32_t now) {
+  uint32_t dt = now - clockLastTick;
+  clockLastTick = now;
+  if (clockPeriod == 0 || dt > CLOCK_TIMEOUT_US) {
+    if (dt > CLOCK_TIMEOUT_US) {
+      // Only the tempo is lost, the position is kept for Continue and
+      // Song Position and only Start moves it back to the beat
+      clockPeriod = 0;
+      clockLockStart = now;
+    } else {
+      clockPeriod = dt;
+    }
+    clockStable = 0;
+    clockLocked = false;
+    return;
+  }
+  float error = (float)dt - clockPeriod;
+  profileRecord(PROF_CLOCK_JITTER, fabsf(error) * PROFILE_TICKS_PER_US);
+  clockPeriod += error * (clockLocked ? CLOCK_PLL_GAIN : CLOCK_PLL_FAST_GAIN);
+  if (fabsf(error) > clockPeriod * (clockLocked ? CLOCK_UNLOCK_TOLERANCE : CLOCK_LOCK_TOLERANCE)) {
+    if (clockLocked) clockLockStart = now;  // Tempo change, lock again
+    clockStable = 0;
+    clockLocked = false;
+  } else if (!clockLocked && ++clockStable >= CLOCK_LOCK_TICKS) {
+    clockLocked = true;
+    profileRecord(PROF_CLOCK_LOCK, (now - clockLockStart) * PROFILE_TICKS_PER_US);
+  }
+}
+
+// Moves the outputs on by one MIDI clock tick
+void clockAdvance() {
+  noInterrupts();
+  clockTimer.end();
+  // Snap to the tick in case the sub tick timer ran slow
+  clockPosition = (clockPosition + CLOCK_SUBTICKS - 1) / CLOCK_SUBTICKS * CLOCK_SUBTICKS;
+  clockSubtick = 0;
+  interrupts();
+  if (clockRunning) clockOutputs(clockPosition++);
+  if (clockPeriod > 0) clockTimer.begin(clockTimerIsr, clockPeriod / CLOCK_SUBTICKS);
+}
+
+// One MIDI clock tick, 24 per quarter note
+void clockTick() {
+  clockTrack(micros());
+  clockAdvance();
+}
+
+void clockStart() {
+  noInterrupts();
+  clockTimer.end();
+  clockPosition = 0;
+  clockRunning = true;
+  interrupts();
+}
+
+void clockStop() {
+  clockRunning = false;
+}
+
+void clockContinue() {
+  clockRunning = true;
+}
+
+// Song position is in 16th notes, 6 MIDI clocks each
+void clockSongPosition(unsigned beats) {
+  noInterrupts();
+  clockTimer.end();
+  clockPosition = beats * 6 * CLOCK_SUBTICKS;
+  interrupts();
+}
+
+// The period is known exactly, so the tracking is skipped
+void masterTimerIsr() {
+  uint32_t now = micros();
+  clockBytesPending++;
+  if (masterLastTick) profileRecord(PROF_MASTER_JITTER, abs((int32_t)(now - masterLastTick) - (int32_t)masterPeriod) * PROFILE_TICKS_PER_US);
+  masterLastTick = now;
+  clockPeriod = masterPeriod;
+  clockLocked = true;
+  clockLastTick = now;
+  clockAdvance();
+}
+
+void masterResume() {
+  masterLastTick = 0;
+  masterActive = true;
+  masterTimer.begin(masterTimerIsr, masterPeriod);
+}
+
+void masterPause() {
+  masterTimer.end();
+  masterActive = false;
+}
+
+void masterStart() {
+  if (masterPlaying) return;
+  masterPlaying = true;
+  MIDI.sendRealTime(midi::Start);
+  usbMIDI.sendRealTime(usbMIDI.Start);
+  usbMIDI.send_now();
+  myStart();
+  masterResume();
+}
+
+void masterStop() {
+  if (!masterPlaying) return;
+  masterPlaying = false;
+  masterPause();
+  MIDI.sendRealTime(midi::Stop);
+  usbMIDI.sendRealTime(usbMIDI.Stop);
+  usbMIDI.send_now();
+  myStop();
+}
+
+void setMasterTempo(int bpm) {
+  masterTempo = bpm;
+  masterPeriod = 60000000.0f / (bpm * 24);
+  if (masterActive) masterTimer.update(masterPeriod);
+  storeTempo(bpm);
+}
+
+void setClockSource(int source) {
+  clockSource = source;
+  storeClockSource(source);
+  if (source == CLOCK_INTERNAL) {
+    masterStart();
+  } else {
+    masterStop();
+  }
+}
+
+// A clock has arrived at myClock(), the external clock takes over
+void clockExternal() {
+  externalClockTime = micros();
+  if (masterActive) masterPause();
+}
+
+// From loop(), sends the queued DIN and USB clocks and brings the internal
+// clock back once the external clock has stopped
+void masterService() {
+  if (clockBytesPending) {
+    noInterrupts();
+    uint8_t pending = clockBytesPending;
+    clockBytesPending = 0;
+    interrupts();
+    while (pending--) {
+      MIDI.sendRealTime(midi::Clock);
+      usbMIDI.sendRealTime(usbMIDI.Clock);
+    }
+    usbMIDI.send_now();
+  }
+  if (masterPlaying && !masterActive && micros() - externalClockTime > CLOCK_TIMEOUT_US) {
+    masterResume();
+  }
+}
+
+float clockBpm() {
+  return clockPeriod > 0 ? 60000000.0f / (clockPeriod * 24) : 0;
+}
+
+boolean clockIsLocked() {
+  return clockLocked;
+}
+
+const char *clockRateName(int gate) {
+  return CLOCK_RATES[gate - GATE_NOTE_MAX - 1].name;
+}
+
+void clockCommand(const char *args) {
+  Serial.print("bpm ");
+  Serial.print(clockBpm(), 1);
+  Serial.println(clockLocked ? " locked" : " unlocked");
+  Serial.print("jitter max us ");
+  Serial.print(profileMaxUs(PROF_CLOCK_JITTER), 1);
+  Serial.print(" avg us ");
+  Serial.println(profileAverageUs(PROF_CLOCK_JITTER), 1);
+  Serial.print("lock time max ms ");
+  Serial.println(profileMaxUs(PROF_CLOCK_LOCK) / 1000, 1);
+  if (masterPlaying) {
+    Serial.print("internal clock ");
+    Serial.print(masterTempo);
+    Serial.print(masterActive ? " bpm running" : " bpm following external");
+    Serial.print(", jitter max us ");
+    Serial.println(profileMaxUs(PROF_MASTER_JITTER), 1);
+  }
+}
+
+// tempo <bpm>
+void tempoCommand(const char *args) {
+  int bpm = atoi(args);
+  if (bpm >= MASTER_TEMPO_MIN && bpm <= MASTER_TEMPO_MAX) setMasterTempo(bpm);
+  Serial.print("tempo ");
+  Serial.println(masterTempo);
+}
+
+void playCommand(const char *args) {
+  masterStart();
+}
+
+void stopCommand(const char *args) {
+  masterStop();
+}
+
+void setupClockEngine() {
+  clockDiv = getClockDiv();
+  clockWidth = getClockWidth();
+  clockSwing = getClockSwing();
+  clockSource = getClockSource();
+  masterTempo = getTempo();
+  masterPeriod = 60000000.0f / (masterTempo * 24);
+  consoleAppend("clock", "tempo, lock and jitter", clockCommand);
+  consoleAppend("tempo", "tempo <bpm> - internal clock tempo", tempoCommand);
+  consoleAppend("play", "start the internal clock", playCommand);
+  consoleAppend("stop", "stop the internal clock", stopCommand);
+}
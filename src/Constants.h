@@ -1,15 +1,40 @@
 const char* VERSION = "V1.5";
 
-#define NO_OF_PARAMS 64
+#define NO_OF_PARAMS 144
+#define PATCH_FIXED_FIELDS 63  // Name to glide time, written in one go by getCurrentPatchData()
+#define PATCH_BEND_FIELD 63    // Pitch bend range on the note CVs
+#define PATCH_MOD_FIELD 64     // First of the modulation routes
+#define PATCH_HIRES_FIELD 80   // 14 bit MSB only timeouts, one per channel output
+#define PATCH_POLYAT_FIELD 96  // Poly aftertouch routing
+#define PATCH_TUNING_FIELD 97  // Scala tuning name, empty for 12-TET
+#define PATCH_QUANT_FIELD 98   // Quantizer scale and root, two fields
+#define PATCH_GEN_FIELD 100    // LFO or envelope settings, one per channel output
+#define PATCH_CURVE_FIELD 116  // Response curve per output
+#define PATCH_CURVE_CUSTOM_FIELD 117  // Custom curve levels, ten fields
+#define PATCH_TRIG_FIELD 127   // Drum trigger pulse widths
+#define PATCH_SEQ_FIELD 128    // Arpeggiator and sequencer settings, then the steps in two fields
+#define PATCH_EUCLID_FIELD 131 // Pattern gates, one field per gate
+#define PATCH_ALLOC_FIELD 139  // Voice allocation strategy
+#define POLY_AT_OFF 0
+#define POLY_AT_VOICES 1
+#define POLY_AT_OUTPUT 2       // Then one mode per channel output
+#define POLY_AT_MODES (POLY_AT_OUTPUT + 16)
 const char* INITPATCHNAME = "Initial Patch";
 #define HOLD_DURATION 1000
 const uint32_t CLICK_DURATION = 250;
 #define PATCHES_LIMIT 999
-#define CHANNEL_PARAMS 5
-#define GATE_PARAMS 60
+#define CHANNEL_PARAMS 12
+#define SF_ADJ_STEP 0.001f  // Scale per SF Adjust setting step
+#define GATE_NOTE_MAX 60
+#define GATE_CLOCK_MODES 12  // Gate values past GATE_NOTE_MAX are clock outputs
+#define GATE_PARAMS (GATE_NOTE_MAX + GATE_CLOCK_MODES)
+#define MASTER_TEMPO_MIN 30
+#define MASTER_TEMPO_MAX 250
+#define PARAM_PAGES 31
+#define MIDI_BATCH 16  // Messages read per port per loop pass, outputs are committed after
 #define CHANNEL_CC_MAX 97
 #define CHANNEL_CC_MIN 3
 #define CHANNEL_MIDI_MAX 16
 #define CHANNEL_MIDI_MIN 1
 
-const String INITPATCH = "8 Note Poly,8,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0";
+const char* INITPATCH = "8 Note Poly,8,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0";
@@ -0,0 +1,264 @@
+/*
+  Control engine - fixed rate tick for anything that moves between MIDI events
+
+  An IntervalTimer runs controlTick() at CONTROL_RATE. Each voice's pitch is
+  held as a 16.16 fixed point DAC code that slews towards its target, either
+  in a straight line that takes glideTime whatever the interval, or
+  exponentially with a time constant of a quarter of glideTime. The legato
+  modes only glide when the voice's gate is still on from the last note.
+  Only codes that changed are written to the PWM.
+
+  The 16 CC outputs ramp to each new value over the time since the previous
+  message for that output, so a CC sweep comes out as a 14 bit slope rather
+  than 128 steps. A value after a pause of more than CC_RAMP_MAX_US ramps
+  over CC_RAMP_JUMP_US instead. Only outputs that are moving are visited on a
+  tick, so all 16 moving at once costs at most 16 short updates.
+
+  Pitch bend can be added to the note CVs as well as the PITCHBEND output.
+  The bend is turned into a DAC code offset once per message, for the
+  patch's range in semitones, and every voice in the poly group is
+  rewritten with it in one pass. The offset is added at the output, so
+  gliding voices carry it too.
+
+  The LFOs and envelopes in Generators.h run at the end of each tick.
+
+  Each tick is timed. Ticks over CONTROL_BUDGET_US are counted as overruns,
+  shown with the tick time on the stats page and by the control command.
+*/
+
+#define CONTROL_RATE 2000  // Hz
+#define CONTROL_US (1000000 / CONTROL_RATE)
+#define CONTROL_BUDGET_US 50  // 10% of a tick for the whole 8 voice update
+#define GLIDE_MAX_MS 3000
+#define CC_OUTPUTS 16
+#define CC_RAMP_MAX_US 50000  // Slower messages than this are taken as separate moves
+#define CC_RAMP_JUMP_US 2000
+#define BEND_RANGE_MAX 24  // Semitones
+
+#define GLIDE_OFF 0
+#define GLIDE_LINEAR 1
+#define GLIDE_EXP 2
+#define GLIDE_LINEAR_LEGATO 3
+#define GLIDE_EXP_LEGATO 4
+#define GLIDE_MODES 5
+
+const char *GLIDE_MODE_NAMES[GLIDE_MODES] = { "Off", "Linear", "Exponential", "Linear Legato", "Exp Legato" };
+const int GLIDE_TIMES[] = { 0, 10, 20, 50, 100, 200, 300, 500, 750, 1000, 1500, 2000, 3000 };
+#define GLIDE_TIME_STEPS (int)(sizeof(GLIDE_TIMES) / sizeof(GLIDE_TIMES[0]))
+
+void genTick();
+
+IntervalTimer controlTimer;
+
+volatile int32_t glideCurrent[NO_OF_VOICES];  // 16.16 DAC codes
+volatile int32_t glideTarget[NO_OF_VOICES];
+volatile int32_t glideStep[NO_OF_VOICES];     // Linear step per tick, 0 for exponential
+volatile uint8_t glideActive = 0;             // One bit per gliding voice
+uint16_t glideOut[NO_OF_VOICES];              // Last code written, with bend
+int32_t glideCoef = 0;                        // 0.16 exponential fraction per tick
+volatile uint32_t controlOverruns = 0;
+
+volatile int32_t ccCurrent[CC_OUTPUTS];  // 16.16 PWM codes
+volatile int32_t ccTarget[CC_OUTPUTS];
+volatile int32_t ccStep[CC_OUTPUTS];
+volatile uint16_t ccActive = 0;          // One bit per ramping output
+uint16_t ccOut[CC_OUTPUTS];
+uint32_t ccLastTime[CC_OUTPUTS];
+
+int glideMode = GLIDE_OFF;  // Patch
+int glideTime = 0;          // ms, patch
+int bendRange = 0;          // Semitones added to the note CVs at full bend, patch, 0 is off
+
+volatile int32_t bendOffset = 0;  // DAC codes added to every voice's pitch
+volatile int32_t voiceBend[NO_OF_VOICES];  // DAC codes added to one voice's pitch, MPE per note bend
+int pitchBendLast = 0;
+
+// Writes a voice's pitch code plus the bend offset if it changed
+inline void pitchWrite(int voice, int32_t code) {
+  uint16_t out = constrain(code + bendOffset + voiceBend[voice], (int32_t)0, (int32_t)16383);
+  if (out != glideOut[voice]) {
+    glideOut[voice] = out;
+    analogWrite(NOTE_PINS[voice], out);
+  }
+}
+
+void setGlideTime(int ms) {
+  glideTime = constrain(ms, 0, GLIDE_MAX_MS);
+  float ticks = glideTime * (CONTROL_RATE / 1000.0f);
+  glideCoef = ticks > 1 ? (1.0f - expf(-4.0f / ticks)) * 65536 : 65536;
+}
+
+void controlTick() {
+  uint32_t start = PROFILE_NOW();
+  uint8_t active = glideActive;
+  while (active) {
+    int voice = __builtin_ctz(active);
+    active &= active - 1;
+    int32_t current = glideCurrent[voice];
+    int32_t target = glideTarget[voice];
+    int32_t step = glideStep[voice];
+    if (step) {
+      current += step;
+      if ((step > 0 && current >= target) || (step < 0 && current <= target)) current = target;
+    } else {
+      int32_t diff = target - current;
+      current += (int32_t)(((int64_t)diff * glideCoef) >> 16);
+      if (abs(diff) < 0x8000) current = target;  // Within half a code
+    }
+    glideCurrent[voice] = current;
+    if (current == target) glideActive &= ~(1 << voice);
+    pitchWrite(voice, (current + 0x8000) >> 16);
+  }
+  uint16_t ramping = ccActive;
+  while (ramping) {
+    int i = __builtin_ctz(ramping);
+    ramping &= ramping - 1;
+    int32_t current = ccCurrent[i] + ccStep[i];
+    int32_t target = ccTarget[i];
+    if ((ccStep[i] > 0 && current >= target) || (ccStep[i] < 0 && current <= target)) {
+      current = target;
+      ccActive &= ~(1 << i);
+    }
+    ccCurrent[i] = current;
+    uint16_t code = (current + 0x8000) >> 16;
+    if (code != ccOut[i]) {
+      ccOut[i] = code;
+      pwmWrite(CC_MAP[i][3], code);
+    }
+  }
+  genTick();
+  uint32_t ticks = PROFILE_NOW() - start;
+  profileRecord(PROF_CONTROL_TICK, ticks);
+  if (ticks > CONTROL_BUDGET_US * PROFILE_TICKS_PER_US) controlOverruns++;
+}
+
+// Sets a voice's pitch DAC code, gliding to it if the patch says so
+void glideTo(int voice, unsigned int code) {
+  int32_t target = (int32_t)code << 16;
+  boolean legato = gateIsOn(voice);
+  boolean glide = glideMode != GLIDE_OFF && glideTime > 0;
+  if (glideMode == GLIDE_LINEAR_LEGATO || glideMode == GLIDE_EXP_LEGATO) glide = glide && legato;
+  noInterrupts();
+  if (!glide || glideCurrent[voice] == target) {
+    glideCurrent[voice] = target;
+    glideTarget[voice] = target;
+    glideActive &= ~(1 << voice);
+    pitchWrite(voice, code);
+  } else {
+    glideTarget[voice] = target;
+    if (glideMode == GLIDE_LINEAR || glideMode == GLIDE_LINEAR_LEGATO) {
+      int32_t ticks = max(1, glideTime * CONTROL_RATE / 1000);
+      int32_t step = (target - glideCurrent[voice]) / ticks;
+      glideStep[voice] = step ? step : (target > glideCurrent[voice] ? 1 : -1);
+    } else {
+      glideStep[voice] = 0;
+    }
+    glideActive |= 1 << voice;
+  }
+  interrupts();
+}
+
+// Ramps CC output i to code over the time since its last message
+void ccSlewTo(int i, unsigned int code) {
+  uint32_t now = micros();
+  uint32_t interval = now - ccLastTime[i];
+  ccLastTime[i] = now;
+  if (interval > CC_RAMP_MAX_US) interval = CC_RAMP_JUMP_US;
+  int32_t ticks = max(1, (int32_t)(interval / CONTROL_US));
+  int32_t target = (int32_t)code << 16;
+  noInterrupts();
+  int32_t step = (target - ccCurrent[i]) / ticks;
+  if (step) {
+    ccTarget[i] = target;
+    ccStep[i] = step;
+    ccActive |= 1 << i;
+  } else {
+    ccCurrent[i] = target;
+    ccTarget[i] = target;
+    ccActive &= ~(1 << i);
+    ccOut[i] = code;
+    pwmWrite(CC_MAP[i][3], code);
+  }
+  interrupts();
+}
+
+// bend is -8192..8191, the voices in the poly group are rewritten in one pass
+void setPitchBend(int bend) {
+  pitchBendLast = bend;
+  int32_t offset = bendRange ? (int32_t)(bend * bendRange * NOTE_SF / 8192) : 0;
+  if (offset == bendOffset) return;
+  noInterrupts();
+  bendOffset = offset;
+  for (int voice = 0; voice < polycount; voice++) {
+    pitchWrite(voice, (glideCurrent[voice] + 0x8000) >> 16);
+  }
+  interrupts();
+}
+
+void setVoiceBend(int voice, int32_t offset) {
+  if (offset == voiceBend[voice]) return;
+  noInterrupts();
+  voiceBend[voice] = offset;
+  pitchWrite(voice, (glideCurrent[voice] + 0x8000) >> 16);
+  interrupts();
+}
+
+void setBendRange(int semitones) {
+  bendRange = constrain(semitones, 0, BEND_RANGE_MAX);
+  setPitchBend(pitchBendLast);
+}
+
+void updateBendRange() {
+  if (bendRange == 0) {
+    showCurrentParameterPage("Bend To Notes", "Off");
+  } else {
+    showCurrentParameterNumber("Bend To Notes", "", bendRange, " semi");
+  }
+}
+
+// Sets CC output i to code straight away, cancelling any ramp
+void ccJumpTo(int i, unsigned int code) {
+  int32_t target = (int32_t)code << 16;
+  ccLastTime[i] = micros();
+  noInterrupts();
+  ccCurrent[i] = target;
+  ccTarget[i] = target;
+  ccActive &= ~(1 << i);
+  ccOut[i] = code;
+  pwmWrite(CC_MAP[i][3], code);
+  interrupts();
+}
+
+void updateGlideTime() {
+  showCurrentParameterNumber("Glide Time", "", glideTime, " ms");
+}
+
+void updateGlideMode() {
+  showCurrentParameterPage("Glide Mode", GLIDE_MODE_NAMES[glideMode]);
+}
+
+// Next or previous step in GLIDE_TIMES from the current time
+int glideTimeStep(int direction) {
+  int i = 0;
+  while (i < GLIDE_TIME_STEPS - 1 && GLIDE_TIMES[i] < glideTime) i++;
+  if (direction > 0 && GLIDE_TIMES[i] <= glideTime) i++;
+  if (direction < 0) i--;
+  return GLIDE_TIMES[constrain(i, 0, GLIDE_TIME_STEPS - 1)];
+}
+
+void controlCommand(const char *args) {
+  Serial.print("control tick avg us ");
+  Serial.print(profileAverageUs(PROF_CONTROL_TICK), 2);
+  Serial.print(" max us ");
+  Serial.print(profileMaxUs(PROF_CONTROL_TICK), 2);
+  Serial.print(" budget us ");
+  Serial.print(CONTROL_BUDGET_US);
+  Serial.print(" overruns ");
+  Serial.println(controlOverruns);
+}
+
+void setupControlEngine() {
+  setGlideTime(glideTime);
+  controlTimer.begin(controlTick, CONTROL_US);
+  consoleAppend("control", "control tick time against its budget", controlCommand);
+}
@@ -0,0 +1,202 @@
+/*
+  Response curves - 7 bit controller values to output codes through tables
+
+  Each curve slot has a 128 entry table of 16 bit levels, copied at patch
+  load from the preset shapes, which are built by the compiler and kept in
+  flash, or from the patch's custom curve. A 7 bit value then costs a lookup,
+  a multiply and a shift to scale it to its output's range, with no divide.
+
+  Slots 0-15 are the channel outputs, then the velocity CVs, mod wheel,
+  aftertouch and breath, in the order of the output slots (pitch bend is 14
+  bit and has no curve, the velocity CVs take its place). Velocity, MPE
+  pressure and poly aftertouch on the voices go through the velocity slot,
+  poly aftertouch on a channel output through that output's slot.
+
+  The patch keeps one hex digit per slot and the custom curve as 128 levels
+  of two hex digits, CURVE_FIELD_POINTS to a field. There is one custom
+  curve per patch, shared by every slot set to custom. A curve for each of
+  the 20 slots would take 200 fields, more than the whole patch line.
+
+  Console: curve lists the slots, curve <slot 1-20> <curve> sets one,
+  curve custom v0,v1,... sets the custom curve from 2 to 128 levels 0-255
+  spread evenly over the 128 values.
+*/
+
+#define CURVE_LINEAR 0
+#define CURVE_EXP 1
+#define CURVE_LOG 2
+#define CURVE_S 3
+#define CURVE_CUSTOM 4
+#define CURVE_TYPES 5
+#define CURVE_PRESETS CURVE_CUSTOM
+
+#define CURVE_VELOCITY OUT_PITCHBEND
+#define CURVE_SLOTS OUTPUTS
+#define CURVE_FIELDS 10
+#define CURVE_FIELD_POINTS 13  // Two hex digits each, 10 fields hold 128
+
+const char *CURVE_NAMES[CURVE_TYPES] = { "linear", "exp", "log", "s-curve", "custom" };
+const char *CURVE_SLOT_NAMES[CURVE_SLOTS - CC_OUTPUTS] = { "velocity", "wheel", "aftertouch", "breath" };
+
+struct CurveShape {
+  uint16_t level[128];
+};
+
+// Cubic shapes, x from 0 to 1 over the 128 values
+constexpr CurveShape curveShape(int type) {
+  CurveShape shape = {};
+  for (int v = 0; v < 128; v++) {
+    double x = v / 127.0;
+    double y = x;
+    if (type == CURVE_EXP) y = x * x * x;
+    if (type == CURVE_LOG) y = 1 - (1 - x) * (1 - x) * (1 - x);
+    if (type == CURVE_S) y = x * x * (3 - 2 * x);
+    shape.level[v] = (uint16_t)(y * 65535 + 0.5);
+  }
+  return shape;
+}
+
+const CurveShape CURVE_SHAPES[CURVE_PRESETS] PROGMEM = {
+  curveShape(CURVE_LINEAR), curveShape(CURVE_EXP), curveShape(CURVE_LOG), curveShape(CURVE_S)
+};
+
+uint8_t curveType[CURVE_SLOTS];       // Patch
+uint8_t curveCustom[128];             // Patch, levels 0-255
+uint16_t curveTable[CURVE_SLOTS][128];
+char curveField[PATCH_FIELD_SIZE];
+
+// 7 bit value to a code from 0 to full
+inline uint16_t curveCode(int slot, uint8_t value, uint16_t full) {
+  return ((uint32_t)curveTable[slot][value & 0x7F] * (full + 1)) >> 16;
+}
+
+void curveBuild(int slot) {
+  if (curveType[slot] == CURVE_CUSTOM) {
+    for (int v = 0; v < 128; v++) {
+      curveTable[slot][v] = curveCustom[v] * 257;
+    }
+  } else {
+    memcpy(curveTable[slot], CURVE_SHAPES[curveType[slot]].level, sizeof(curveTable[slot]));
+  }
+}
+
+void setCurve(int slot, int type) {
+  curveType[slot] = constrain(type, 0, CURVE_TYPES - 1);
+  curveBuild(slot);
+}
+
+void curveRebuildCustom() {
+  for (int slot = 0; slot < CURVE_SLOTS; slot++) {
+    if (curveType[slot] == CURVE_CUSTOM) curveBuild(slot);
+  }
+}
+
+// Curve per slot, missing slots are linear
+void curveParse(const char *field) {
+  size_t length = strlen(field);
+  for (int slot = 0; slot < CURVE_SLOTS; slot++) {
+    char digit[2] = { (size_t)slot < length ? field[slot] : '0', 0 };
+    setCurve(slot, strtol(digit, NULL, 16));
+  }
+}
+
+const char *curveFormat() {
+  for (int slot = 0; slot < CURVE_SLOTS; slot++) {
+    snprintf(curveField + slot, 2, "%X", curveType[slot]);
+  }
+  return curveField;
+}
+
+// One field of the custom curve, missing levels follow the linear curve
+void curveParseCustom(int part, const char *field) {
+  size_t length = strlen(field);
+  for (int k = 0; k < CURVE_FIELD_POINTS; k++) {
+    int v = part * CURVE_FIELD_POINTS + k;
+    if (v >= 128) break;
+    if (length >= (size_t)(k + 1) * 2) {
+      char digits[3] = { field[k * 2], field[k * 2 + 1], 0 };
+      curveCustom[v] = strtol(digits, NULL, 16);
+    } else {
+      curveCustom[v] = v * 255 / 127;
+    }
+  }
+  if (part == CURVE_FIELDS - 1) curveRebuildCustom();
+}
+
+const char *curveFormatCustom(int part) {
+  curveField[0] = 0;
+  for (int k = 0; k < CURVE_FIELD_POINTS; k++) {
+    int v = part * CURVE_FIELD_POINTS + k;
+    if (v >= 128) break;
+    snprintf(curveField + k * 2, 3, "%02X", curveCustom[v]);
+  }
+  return curveField;
+}
+
+// Custom curve through count evenly spaced levels
+void curveSetCustom(const int *levels, int count) {
+  for (int v = 0; v < 128; v++) {
+    int position = v * (count - 1);
+    int k = position / 127;
+    int within = position - k * 127;
+    int next = min(k + 1, count - 1);
+    curveCustom[v] = (levels[k] * (127 - within) + levels[next] * within) / 127;
+  }
+  curveRebuildCustom();
+}
+
+void curvePrintSlot(int slot) {
+  Serial.print(slot + 1);
+  Serial.print(" ");
+  if (slot < CC_OUTPUTS) {
+    Serial.print("ch");
+    Serial.print(slot + 1);
+  } else {
+    Serial.print(CURVE_SLOT_NAMES[slot - CC_OUTPUTS]);
+  }
+  Serial.print(" ");
+  Serial.println(CURVE_NAMES[curveType[slot]]);
+}
+
+void curveCommand(const char *args) {
+  int slot = 0, type = 0;
+  if (strncmp(args, "custom", 6) == 0) {
+    int levels[128];
+    int count = 0;
+    char *end;
+    const char *p = args + 6;
+    while (count < 128) {
+      long level = strtol(p, &end, 10);
+      if (end == p) break;
+      levels[count++] = constrain(level, 0L, 255L);
+      p = end;
+      while (*p == ',' || *p == ' ') p++;
+    }
+    if (count < 2) {
+      Serial.println("curve custom needs at least two levels 0-255");
+      return;
+    }
+    curveSetCustom(levels, count);
+  } else if (sscanf(args, "%d %d", &slot, &type) == 2 && slot >= 1 && slot <= CURVE_SLOTS) {
+    setCurve(slot - 1, type);
+  } else if (args[0]) {
+    Serial.println("curve <slot 1-20> <curve>, curve custom v0,v1,..., curves:");
+    for (int t = 0; t < CURVE_TYPES; t++) {
+      Serial.print(t);
+      Serial.print(" ");
+      Serial.println(CURVE_NAMES[t]);
+    }
+    return;
+  }
+  for (int s = 0; s < CURVE_SLOTS; s++) {
+    curvePrintSlot(s);
+  }
+}
+
+void setupCurves() {
+  curveParse("");
+  for (int part = 0; part < CURVE_FIELDS; part++) {
+    curveParseCustom(part, "");
+  }
+  consoleAppend("curve", "curve <slot> <curve> - response curves, curve custom v0,v1,...", curveCommand);
+}
@@ -14,6 +14,19 @@
 #define ADDR_OCTAVE 28
 #define ADDR_KEYBOARD_MODE 30
 #define ADDR_SF_ADJUST 32
+#define ADDR_CHAIN_MODE 64
+#define ADDR_CHAIN_UNITS 65
+#define ADDR_DISPLAY_SLICE 66
+#define ADDR_GATE_DELAY 67  // 8 bytes, one per voice
+#define ADDR_RETRIG_GAP 75
+#define ADDR_CLOCK_DIV 76
+#define ADDR_CLOCK_WIDTH 77
+#define ADDR_CLOCK_SWING 78
+#define ADDR_TEMPO 79
+#define ADDR_MPE_ZONE 80
+#define ADDR_MPE_EXPRESSION 81
+#define ADDR_MPE_MEMBERS 82
+#define ADDR_CALIBRATION 128  // Calibration table with its CRC, 442 bytes
 
 
 int getMIDIChannel() {
@@ -71,15 +84,168 @@ void storeTranspose(byte eepromtranspose)
   EEPROM.update(ADDR_TRANSPOSE, eepromtranspose);
 }
 
-int getSFAdjust(byte SFAdjustNumber) {
-  sfAdj[SFAdjustNumber] = EEPROM.read(ADDR_SF_ADJUST + SFAdjustNumber);
-  if (sfAdj[SFAdjustNumber] < 0 || sfAdj[SFAdjustNumber] > 25) sfAdj[SFAdjustNumber] = 13;
-  return sfAdj[SFAdjustNumber];
+float getSFAdjust(byte SFAdjustNumber) {
+  float sf;
+  EEPROM.get(ADDR_SF_ADJUST + SFAdjustNumber * sizeof(float), sf);
+  if ((sf < 0.9f) || (sf > 1.1f) || isnan(sf)) sf = 1.0f;
+  return sf;
 }
 
-void storeSFAdjust(byte SFAdjustNumber, byte SFAdjustValue)
+void storeSFAdjust(byte SFAdjustNumber, float SFAdjustValue)
 {
-  EEPROM.update(ADDR_SF_ADJUST + SFAdjustNumber, sfAdj[SFAdjustNumber]);
+  EEPROM.put(ADDR_SF_ADJUST + SFAdjustNumber * sizeof(float), SFAdjustValue);
+}
+
+int getChainMode() {
+  byte chainMode = EEPROM.read(ADDR_CHAIN_MODE);
+  if (chainMode < 0 || chainMode > 3) chainMode = 0; //If EEPROM has no chain mode stored
+  return chainMode;
+}
+
+void storeChainMode(byte chainMode)
+{
+  EEPROM.update(ADDR_CHAIN_MODE, chainMode);
+}
+
+int getChainUnits() {
+  byte chainUnits = EEPROM.read(ADDR_CHAIN_UNITS);
+  if (chainUnits < 1 || chainUnits > 3) chainUnits = 1;
+  return chainUnits;
+}
+
+void storeChainUnits(byte chainUnits)
+{
+  EEPROM.update(ADDR_CHAIN_UNITS, chainUnits);
+}
+
+int getDisplaySlice() {
+  byte displaySlice = EEPROM.read(ADDR_DISPLAY_SLICE);
+  if (displaySlice < 1 || displaySlice > 10) displaySlice = 2;
+  return displaySlice;
+}
+
+void storeDisplaySlice(byte displaySlice)
+{
+  EEPROM.update(ADDR_DISPLAY_SLICE, displaySlice);
+}
+
+int getGateDelay(int voice) {
+  byte gateDelay = EEPROM.read(ADDR_GATE_DELAY + voice);
+  if (gateDelay == 255) gateDelay = 0;  //If EEPROM has no gate delay stored
+  return gateDelay;
+}
+
+void storeGateDelay(int voice, byte gateDelay)
+{
+  EEPROM.update(ADDR_GATE_DELAY + voice, gateDelay);
+}
+
+int getRetrigGap() {
+  byte retrigGap = EEPROM.read(ADDR_RETRIG_GAP);
+  if (retrigGap == 255) retrigGap = 0;  //If EEPROM has no retrigger gap stored
+  return retrigGap;
+}
+
+void storeRetrigGap(byte retrigGap)
+{
+  EEPROM.update(ADDR_RETRIG_GAP, retrigGap);
+}
+
+int getClockDiv() {
+  byte clockDiv = EEPROM.read(ADDR_CLOCK_DIV);
+  if (clockDiv != 2 && clockDiv != 4 && clockDiv != 8) clockDiv = 1;
+  return clockDiv;
+}
+
+void storeClockDiv(byte clockDiv)
+{
+  EEPROM.update(ADDR_CLOCK_DIV, clockDiv);
+}
+
+int getClockWidth() {
+  byte clockWidth = EEPROM.read(ADDR_CLOCK_WIDTH);
+  if (clockWidth < 1 || clockWidth > 60) clockWidth = 10;
+  return clockWidth;
+}
+
+void storeClockWidth(byte clockWidth)
+{
+  EEPROM.update(ADDR_CLOCK_WIDTH, clockWidth);
+}
+
+int getClockSwing() {
+  byte clockSwing = EEPROM.read(ADDR_CLOCK_SWING);
+  if (clockSwing < 50 || clockSwing > 75) clockSwing = 50;
+  return clockSwing;
+}
+
+void storeClockSwing(byte clockSwing)
+{
+  EEPROM.update(ADDR_CLOCK_SWING, clockSwing);
+}
+
+int getClockSource() {
+  byte clockSource = EEPROM.read(EEPROM_CLOCKSOURCE);
+  if (clockSource > 1) clockSource = 0;
+  return clockSource;
+}
+
+void storeClockSource(byte clockSource)
+{
+  EEPROM.update(EEPROM_CLOCKSOURCE, clockSource);
+}
+
+int getTempo() {
+  byte tempo = EEPROM.read(ADDR_TEMPO);
+  if (tempo < MASTER_TEMPO_MIN || tempo > MASTER_TEMPO_MAX) tempo = 120;
+  return tempo;
+}
+
+void storeTempo(byte tempo)
+{
+  EEPROM.update(ADDR_TEMPO, tempo);
+}
+
+int getMpeZone() {
+  byte mpeZone = EEPROM.read(ADDR_MPE_ZONE);
+  if (mpeZone > 2) mpeZone = 0;
+  return mpeZone;
+}
+
+void storeMpeZone(byte mpeZone)
+{
+  EEPROM.update(ADDR_MPE_ZONE, mpeZone);
+}
+
+int getMpeExpression() {
+  byte mpeExpression = EEPROM.read(ADDR_MPE_EXPRESSION);
+  if (mpeExpression > 1) mpeExpression = 0;
+  return mpeExpression;
+}
+
+void storeMpeExpression(byte mpeExpression)
+{
+  EEPROM.update(ADDR_MPE_EXPRESSION, mpeExpression);
+}
+
+int getMpeMembers() {
+  byte mpeMembers = EEPROM.read(ADDR_MPE_MEMBERS);
+  if (mpeMembers > 15) mpeMembers = 15;
+  return mpeMembers;
+}
+
+void storeMpeMembers(byte mpeMembers)
+{
+  EEPROM.update(ADDR_MPE_MEMBERS, mpeMembers);
+}
+
+void getCalibration(uint8_t *table, size_t size) {
+  for (size_t i = 0; i < size; i++) table[i] = EEPROM.read(ADDR_CALIBRATION + i);
+}
+
+void storeCalibration(const uint8_t *table, size_t size)
+{
+  for (size_t i = 0; i < size; i++) EEPROM.update(ADDR_CALIBRATION + i, table[i]);
 }
 
 int getOctave() {
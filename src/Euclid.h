@@ -0,0 +1,170 @@
+/*
+  Pattern gates - Euclidean, probability and ratchet triggers on free gates
+
+  A free gate with a pattern is driven by it instead of its note or clock
+  rate. The pattern spreads its pulses as evenly as possible over its steps,
+  rotated, and each pulse can be split into up to EUCLID_RATCHET_MAX ratchets
+  within the step. Patterns are expanded when they're set into a bitmask
+  over the whole cycle in clock sub ticks, one bit per pulse and ratchet and
+  a second mask marking the first pulse of each step, so a clock sub tick
+  costs each gate a bit test. The probability is rolled on the first pulse
+  of a step and its ratchets follow it.
+
+  Pulses go out through the gate scheduler from clockOutputs(), with the
+  Clock Width setting capped at half the ratchet interval like the clock
+  outputs.
+
+  The patch stores steps:pulses:rotation:rate:probability %:ratchets for
+  each gate, 0 steps for no pattern.
+
+  Console: euclid lists the patterns,
+  euclid <gate 1-8> <steps> <pulses> <rotation> <rate> <probability %> <ratchets>
+  sets one.
+*/
+
+#define EUCLID_STEPS_MAX 32
+#define EUCLID_RATCHET_MAX 4
+#define EUCLID_SETTINGS 6
+#define EUCLID_WORDS (EUCLID_STEPS_MAX * CLOCK_QUARTER / 32)
+
+struct EuclidPattern {
+  uint8_t setting[EUCLID_SETTINGS];  // Patch
+  uint16_t cycle;                    // Sub ticks in the whole pattern
+  uint16_t interval;                 // Sub ticks between ratchets
+  uint32_t pulses[EUCLID_WORDS];
+  uint32_t starts[EUCLID_WORDS];
+};
+
+EuclidPattern euclid[NO_OF_VOICES];
+uint8_t euclidGates = 0;  // Gates with a pattern
+uint8_t euclidHit = 0;    // Gates whose current step passed its probability roll
+uint32_t euclidRandom = 1;
+uint32_t euclidFired = 0;
+uint32_t euclidSkipped = 0;
+char euclidField[PATCH_FIELD_SIZE];
+
+void trigBuild();
+
+inline boolean euclidBit(const uint32_t *mask, uint32_t tick) {
+  return mask[tick >> 5] & (1UL << (tick & 31));
+}
+
+void euclidBuild(int g) {
+  EuclidPattern &p = euclid[g];
+  int steps = p.setting[0];
+  int pulses = p.setting[1];
+  int subticks = STEP_RATE_SUBTICKS[p.setting[3]];
+  int ratchets = p.setting[5];
+  EuclidPattern built = p;
+  memset(built.pulses, 0, sizeof(built.pulses));
+  memset(built.starts, 0, sizeof(built.starts));
+  built.cycle = max(steps, 1) * subticks;
+  built.interval = subticks / ratchets;
+  for (int step = 0; step < steps; step++) {
+    if ((step + p.setting[2]) * pulses % steps >= pulses) continue;
+    uint32_t tick = step * subticks;
+    built.starts[tick >> 5] |= 1UL << (tick & 31);
+    for (int r = 0; r < ratchets; r++, tick += built.interval) {
+      built.pulses[tick >> 5] |= 1UL << (tick & 31);
+    }
+  }
+  noInterrupts();
+  p = built;
+  if (steps && pulses) {
+    euclidGates |= 1 << g;
+  } else {
+    euclidGates &= ~(1 << g);
+  }
+  interrupts();
+}
+
+// From clockOutputs(), every sub tick
+void euclidClock(uint32_t position) {
+  uint8_t gates = euclidGates & (0xFF << polycount);
+  if (!gates) return;
+  uint32_t subtickUs = clockPeriod / CLOCK_SUBTICKS;
+  while (gates) {
+    int g = __builtin_ctz(gates);
+    gates &= gates - 1;
+    EuclidPattern &p = euclid[g];
+    uint32_t tick = position % p.cycle;
+    if (!euclidBit(p.pulses, tick)) continue;
+    if (euclidBit(p.starts, tick)) {
+      euclidRandom = euclidRandom * 1664525 + 1013904223;
+      if ((euclidRandom >> 16) % 100 < p.setting[4]) {
+        euclidHit |= 1 << g;
+      } else {
+        euclidHit &= ~(1 << g);
+        euclidSkipped++;
+      }
+    }
+    if (!(euclidHit & (1 << g))) continue;
+    uint32_t width = clockWidth * 1000;
+    if (subtickUs) width = min(width, p.interval * subtickUs / 2);
+    gateSchedule(g, HIGH, 0, width);
+    euclidFired++;
+  }
+}
+
+void setEuclid(int g, const int *settings) {
+  uint8_t *s = euclid[g].setting;
+  s[0] = constrain(settings[0], 0, EUCLID_STEPS_MAX);
+  s[1] = constrain(settings[1], 0, (int)s[0]);
+  s[2] = constrain(settings[2], 0, max((int)s[0] - 1, 0));
+  s[3] = constrain(settings[3], 0, STEP_RATES - 1);
+  s[4] = constrain(settings[4], 0, 100);
+  s[5] = constrain(settings[5], 1, EUCLID_RATCHET_MAX);
+  euclidBuild(g);
+  trigBuild();
+}
+
+void euclidParse(int g, const char *field) {
+  int settings[EUCLID_SETTINGS] = { 0, 0, 0, 2, 100, 1 };
+  sscanf(field, "%d:%d:%d:%d:%d:%d", &settings[0], &settings[1], &settings[2], &settings[3], &settings[4], &settings[5]);
+  setEuclid(g, settings);
+}
+
+const char *euclidFormat(int g) {
+  const uint8_t *s = euclid[g].setting;
+  snprintf(euclidField, sizeof(euclidField), "%d:%d:%d:%d:%d:%d", s[0], s[1], s[2], s[3], s[4], s[5]);
+  return euclidField;
+}
+
+void euclidCommand(const char *args) {
+  int gate = 0;
+  int settings[EUCLID_SETTINGS];
+  if (sscanf(args, "%d %d %d %d %d %d %d", &gate, &settings[0], &settings[1], &settings[2], &settings[3], &settings[4], &settings[5]) == 7
+      && gate >= 1 && gate <= NO_OF_VOICES) {
+    setEuclid(gate - 1, settings);
+  } else if (args[0]) {
+    Serial.println("euclid <gate 1-8> <steps, 0 off> <pulses> <rotation> <rate> <probability %> <ratchets 1-4>");
+    return;
+  }
+  for (int g = 0; g < NO_OF_VOICES; g++) {
+    if (!(euclidGates & (1 << g))) continue;
+    const EuclidPattern &p = euclid[g];
+    Serial.print("gate ");
+    Serial.print(g + 1);
+    Serial.print(g < polycount ? " (voice) " : " ");
+    for (int step = 0; step < p.setting[0]; step++) {
+      Serial.print(euclidBit(p.starts, step * STEP_RATE_SUBTICKS[p.setting[3]]) ? "x" : ".");
+    }
+    Serial.print(" ");
+    Serial.print(STEP_RATE_NAMES[p.setting[3]]);
+    Serial.print(" probability ");
+    Serial.print(p.setting[4]);
+    Serial.print("% ratchets ");
+    Serial.println(p.setting[5]);
+  }
+  Serial.print("pulses fired ");
+  Serial.print(euclidFired);
+  Serial.print(" steps skipped ");
+  Serial.println(euclidSkipped);
+}
+
+void setupEuclid() {
+  for (int g = 0; g < NO_OF_VOICES; g++) {
+    euclidParse(g, "");
+  }
+  consoleAppend("euclid", "Euclidean, probability and ratchet patterns on free gates", euclidCommand);
+}
@@ -0,0 +1,188 @@
+/*
+  Gate scheduler - microsecond timed shift register writes
+
+  Each shift register output can have one pending write, due at a time in
+  micros(). A single IntervalTimer is armed for the earliest one and re-armed
+  from its interrupt for the next. A write can also carry a pulse width, in
+  which case the output is taken low again that many us after it goes high.
+
+  Every other shift register write goes through srSet(), which blocks the
+  timer interrupt for the few us the shift out takes and cancels anything
+  still pending on that output, so a note off always wins over a gate that
+  is still waiting for its pitch to settle.
+
+  Pitch to gate delay: the 9155Hz PWM filter needs time to settle after the
+  pitch is written, so the gate is raised gateDelay[voice] us later.
+  Retrigger gap: in Mono and Unison modes a new note drops the gate for
+  retrigGap us before raising it again, so envelopes restart.
+*/
+
+#define SR_OUTPUTS 32
+#define GATE_DELAY_STEP 10    // EEPROM stores the pitch to gate delay in 10us steps
+#define RETRIG_GAP_STEP 100   // and the retrigger gap in 100us steps
+
+IntervalTimer gateTimer;
+
+volatile uint32_t gatePending = 0;  // One bit per shift register output
+volatile uint32_t gateDue[SR_OUTPUTS];
+volatile uint32_t gateWidth[SR_OUTPUTS];
+volatile uint8_t gateValue[SR_OUTPUTS];
+
+uint32_t gateDelay[NO_OF_VOICES];  // us from pitch write to gate on, per voice
+uint32_t retrigGap = 0;           // us the gate is held low between mono/unison notes
+boolean noteRetrigger = false;     // Set while a note on is being handled in mono/unison
+
+void gateTimerIsr();
+void genGate(int voice, boolean on);
+
+// Arms the timer for the earliest pending write, interrupts must be off
+void gateArm(uint32_t now) {
+  if (!gatePending) {
+    gateTimer.end();
+    return;
+  }
+  int32_t next = 0x7FFFFFFF;
+  uint32_t pending = gatePending;
+  while (pending) {
+    int i = __builtin_ctz(pending);
+    pending &= pending - 1;
+    int32_t wait = (int32_t)(gateDue[i] - now);
+    if (wait < next) next = wait;
+  }
+  gateTimer.begin(gateTimerIsr, next > 1 ? next : 1);
+}
+
+void gateTimerIsr() {
+  uint32_t now = micros();
+  uint32_t pending = gatePending;
+  while (pending) {
+    int i = __builtin_ctz(pending);
+    pending &= pending - 1;
+    int32_t late = (int32_t)(now - gateDue[i]);
+    if (late < 0) continue;
+    profileRecord(PROF_GATE_LATE, late * PROFILE_TICKS_PER_US);
+    sr.set(i, gateValue[i]);
+    if (gateValue[i] && gateWidth[i]) {
+      gateDue[i] = gateDue[i] + gateWidth[i];
+      gateValue[i] = LOW;
+      gateWidth[i] = 0;
+    } else {
+      gatePending &= ~(1UL << i);
+    }
+  }
+  gateArm(micros());
+}
+
+// Immediate write, cancels any pending write to the same output
+void srSet(uint8_t output, uint8_t value) {
+  noInterrupts();
+  gatePending &= ~(1UL << output);
+  sr.set(output, value);
+  interrupts();
+}
+
+// Writes value to output after delay us, then takes it low again after width us
+void gateSchedule(uint8_t output, uint8_t value, uint32_t delay, uint32_t width = 0) {
+  if (delay == 0) {
+    srSet(output, value);
+    if (!(value && width)) return;
+    value = LOW;
+    delay = width;
+    width = 0;
+  }
+  noInterrupts();
+  uint32_t now = micros();
+  gateDue[output] = now + delay;
+  gateValue[output] = value;
+  gateWidth[output] = width;
+  gatePending |= 1UL << output;
+  gateArm(now);
+  interrupts();
+}
+
+// True if the gate is high or about to go high
+boolean gateIsOn(int voice) {
+  uint8_t output = GATE_PINS[voice];
+  return sr.get(output) || (gatePending & (1UL << output));
+}
+
+// Raise a voice gate once its pitch has settled. A gate that is already high
+// stays high (legato) unless retrigger is set and there is a retrigger gap.
+void gateOn(int voice, boolean retrigger) {
+  uint8_t output = GATE_PINS[voice];
+  if (!gateIsOn(voice)) {
+    gateSchedule(output, HIGH, gateDelay[voice]);
+  } else if (retrigger && retrigGap) {
+    srSet(output, LOW);
+    gateSchedule(output, HIGH, max(retrigGap, gateDelay[voice]));
+  }
+  srSet(NOTE_LEDS[voice], HIGH);
+  genGate(voice, true);
+}
+
+void gateOff(int voice) {
+  srSet(GATE_PINS[voice], LOW);
+  srSet(NOTE_LEDS[voice], LOW);
+  genGate(voice, false);
+}
+
+// Takes several voice gates and their LEDs low in one shift register update
+void gatesOff(uint8_t voices) {
+  uint8_t pending = voices;
+  noInterrupts();
+  while (pending) {
+    int voice = __builtin_ctz(pending);
+    pending &= pending - 1;
+    gatePending &= ~((1UL << GATE_PINS[voice]) | (1UL << NOTE_LEDS[voice]));
+    sr.setNoUpdate(GATE_PINS[voice], LOW);
+    sr.setNoUpdate(NOTE_LEDS[voice], LOW);
+  }
+  sr.updateRegisters();
+  interrupts();
+  while (voices) {
+    int voice = __builtin_ctz(voices);
+    voices &= voices - 1;
+    genGate(voice, false);
+  }
+}
+
+void setGateDelay(int voice, uint32_t us) {
+  gateDelay[voice] = us;
+  storeGateDelay(voice, us / GATE_DELAY_STEP);
+}
+
+void setAllGateDelays(uint32_t us) {
+  for (int i = 0; i < NO_OF_VOICES; i++) {
+    setGateDelay(i, us);
+  }
+}
+
+void setRetrigGap(uint32_t us) {
+  retrigGap = us;
+  storeRetrigGap(us / RETRIG_GAP_STEP);
+}
+
+// gatedelay <voice 1-8> <us>, or gatedelay on its own to list them
+void gateDelayCommand(const char *args) {
+  int voice = 0;
+  int us = 0;
+  if (sscanf(args, "%d %d", &voice, &us) == 2 && voice >= 1 && voice <= NO_OF_VOICES) {
+    setGateDelay(voice - 1, constrain(us, 0, 254 * GATE_DELAY_STEP));
+  }
+  for (int i = 0; i < NO_OF_VOICES; i++) {
+    Serial.print("voice ");
+    Serial.print(i + 1);
+    Serial.print(" gate delay us ");
+    Serial.println(gateDelay[i]);
+  }
+  Serial.print("retrigger gap us ");
+  Serial.println(retrigGap);
+}
+
+void setupGateScheduler() {
+  for (int i = 0; i < NO_OF_VOICES; i++) {
+    gateDelay[i] = getGateDelay(i) * GATE_DELAY_STEP;
+  }
+  retrigGap = getRetrigGap() * RETRIG_GAP_STEP;
+  consoleAppend("gatedelay", "gatedelay <voice> <us> - pitch to gate delay", gateDelayCommand);
+}
@@ -0,0 +1,307 @@
+/*
+  Generators - LFOs and envelopes on the channel outputs
+
+  A channel output in LFO or Envelope mode is driven from the control tick.
+  LFOs are 32 bit phase accumulators read through a 256 entry wave table,
+  free running in hundredths of a Hz or locked to the clock. A synced LFO
+  runs at the clock tempo between sub ticks, and each time the clock
+  position moves its phase is set from the position, so it starts with the
+  bar on Start, follows Continue and Song Position, and can't drift. Envelopes
+  are linear ADSRs whose step per tick is worked out when the times are set,
+  or at the gate off for the release, so a tick is only adds and compares
+  for every generator whatever its settings. The tick is timed on its own
+  against GEN_BUDGET_US.
+
+  Envelope triggers: 0 is any gate of the poly group, 1-8 one voice's gate,
+  a higher number a note on the gate channel.
+
+  Each output's five settings are kept in the patch, meaning by mode:
+    LFO       wave:rate:sync:level:offset
+    Envelope  attack:decay:sustain:release:trigger
+  rate is in 0.01Hz and sync, when not 0, is a division from GEN_SYNC_NAMES.
+  level, offset and sustain are percentages of 10V, times are in ms.
+
+  Console: gen lists them, gen <output 1-16> <five settings> sets one.
+*/
+
+#define GEN_LFO_MODE 10
+#define GEN_ENV_MODE 11
+#define GEN_SETTINGS 5
+#define GEN_BUDGET_US 20
+#define GEN_FULL_SCALE 15440  // 10V
+#define GEN_LEVEL_BITS 24     // Envelope level, 1 << 24 is full
+#define GEN_TIME_MAX 9999     // ms
+
+#define LFO_SINE 0
+#define LFO_TRIANGLE 1
+#define LFO_SAW 2
+#define LFO_RAMP 3
+#define LFO_SQUARE 4
+#define LFO_RANDOM 5
+#define LFO_WAVES 6
+
+#define ENV_IDLE 0
+#define ENV_ATTACK 1
+#define ENV_DECAY 2
+#define ENV_SUSTAIN 3
+#define ENV_RELEASE 4
+
+#define GEN_SYNCS 7
+
+const char *LFO_WAVE_NAMES[LFO_WAVES] = { "sine", "triangle", "saw", "ramp", "square", "random" };
+const char *GEN_SYNC_NAMES[GEN_SYNCS] = { "free", "1/16", "1/8", "1/4", "1/2", "1 bar", "2 bars" };
+const uint16_t GEN_SYNC_SUBTICKS[GEN_SYNCS] = { 0, CLOCK_QUARTER / 4, CLOCK_QUARTER / 2, CLOCK_QUARTER,
+                                                CLOCK_QUARTER * 2, CLOCK_QUARTER * 4, CLOCK_QUARTER * 8 };  // Clock sub ticks per cycle
+
+int16_t sineTable[256];
+
+struct Generator {
+  int16_t setting[GEN_SETTINGS];
+  uint32_t phase;
+  uint32_t increment;  // Phase per tick
+  uint16_t cycle;      // Clock sub ticks per cycle when synced, 0 when free
+  int32_t span;        // LFO codes peak to peak
+  int32_t base;        // LFO code at the bottom of the wave
+  uint16_t random;
+  uint8_t stage;
+  int32_t level;       // Envelope, 8.24
+  int32_t attackStep;
+  int32_t decayStep;
+  int32_t sustain;
+  int32_t releaseStep;
+  uint16_t out;        // Last code written
+};
+
+Generator generators[CC_OUTPUTS];
+volatile uint32_t genOverruns = 0;
+uint32_t genRandom = 1;
+float genBpm = 0;
+uint32_t genPosition = 0;  // Clock position at the last tick
+char genField[PATCH_FIELD_SIZE];
+
+boolean genMode(int i) {
+  return CC_MAP[i][2] == 0 && (CC_MAP[i][4] == GEN_LFO_MODE || CC_MAP[i][4] == GEN_ENV_MODE);
+}
+
+int32_t genStep(int32_t range, int ms) {
+  int32_t ticks = max(1, ms * CONTROL_RATE / 1000);
+  return max((int32_t)1, range / ticks);
+}
+
+void genIncrement(int i) {
+  Generator &gen = generators[i];
+  int sync = constrain((int)gen.setting[2], 0, GEN_SYNCS - 1);
+  gen.cycle = GEN_SYNC_SUBTICKS[sync];
+  float hz = sync && genBpm > 0 ? genBpm / 60.0f * CLOCK_QUARTER / gen.cycle : gen.setting[1] / 100.0f;
+  gen.increment = hz * 4294967296.0f / CONTROL_RATE;
+}
+
+// Works out the per tick steps from the settings, for both modes as the
+// output's mode can change without them
+void genPrepare(int i) {
+  Generator &gen = generators[i];
+  genIncrement(i);
+  gen.span = constrain((int)gen.setting[3], 0, 100) * GEN_FULL_SCALE / 100;
+  gen.base = gen.setting[4] * GEN_FULL_SCALE / 100;
+  gen.sustain = (int32_t)gen.setting[2] * (1 << GEN_LEVEL_BITS) / 100;
+  gen.attackStep = genStep(1 << GEN_LEVEL_BITS, gen.setting[0]);
+  gen.decayStep = genStep((1 << GEN_LEVEL_BITS) - gen.sustain, gen.setting[1]);
+}
+
+uint16_t genLfo(Generator &gen) {
+  uint32_t previous = gen.phase;
+  gen.phase += gen.increment;
+  int32_t wave;  // -32767..32767
+  switch (gen.setting[0]) {
+    case LFO_TRIANGLE:
+      wave = gen.phase < 0x80000000 ? (int32_t)(gen.phase >> 15) - 32768 : 98303 - (int32_t)(gen.phase >> 15);
+      break;
+    case LFO_SAW:
+      wave = (int32_t)(gen.phase >> 16) - 32768;
+      break;
+    case LFO_RAMP:
+      wave = 32767 - (int32_t)(gen.phase >> 16);
+      break;
+    case LFO_SQUARE:
+      wave = gen.phase < 0x80000000 ? 32767 : -32767;
+      break;
+    case LFO_RANDOM:
+      if (gen.phase < previous) {
+        genRandom = genRandom * 1664525 + 1013904223;
+        gen.random = genRandom >> 16;
+      }
+      wave = (int32_t)gen.random - 32768;
+      break;
+    default:
+      wave = sineTable[gen.phase >> 24];
+      break;
+  }
+  return constrain(gen.base + gen.span / 2 + ((wave * gen.span) >> 16), (int32_t)0, (int32_t)PWM_MAX);
+}
+
+uint16_t genEnvelope(Generator &gen) {
+  switch (gen.stage) {
+    case ENV_ATTACK:
+      gen.level += gen.attackStep;
+      if (gen.level >= (1 << GEN_LEVEL_BITS)) {
+        gen.level = 1 << GEN_LEVEL_BITS;
+        gen.stage = ENV_DECAY;
+      }
+      break;
+    case ENV_DECAY:
+      gen.level -= gen.decayStep;
+      if (gen.level <= gen.sustain) {
+        gen.level = gen.sustain;
+        gen.stage = ENV_SUSTAIN;
+      }
+      break;
+    case ENV_RELEASE:
+      gen.level -= gen.releaseStep;
+      if (gen.level <= 0) {
+        gen.level = 0;
+        gen.stage = ENV_IDLE;
+      }
+      break;
+  }
+  return ((int64_t)gen.level * GEN_FULL_SCALE) >> GEN_LEVEL_BITS;
+}
+
+// From the control tick
+void genTick() {
+  uint32_t start = PROFILE_NOW();
+  uint32_t position = clockPosition;
+  boolean moved = position != genPosition;
+  genPosition = position;
+  uint32_t last = position ? position - 1 : 0;  // The sub tick that has just gone out
+  for (int i = 0; i < CC_OUTPUTS; i++) {
+    if (!genMode(i) || (outputMatrix & (1UL << i))) continue;
+    Generator &gen = generators[i];
+    if (moved && gen.cycle && CC_MAP[i][4] == GEN_LFO_MODE) {
+      // Less one increment, genLfo() adds it back and sees the wrap at the cycle start
+      gen.phase = (uint32_t)(((uint64_t)(last % gen.cycle) << 32) / gen.cycle) - gen.increment;
+    }
+    uint16_t code = CC_MAP[i][4] == GEN_LFO_MODE ? genLfo(gen) : genEnvelope(gen);
+    if (code != gen.out) {
+      gen.out = code;
+      pwmWrite(CC_MAP[i][3], code);
+    }
+  }
+  uint32_t ticks = PROFILE_NOW() - start;
+  profileRecord(PROF_GEN_TICK, ticks);
+  if (ticks > GEN_BUDGET_US * PROFILE_TICKS_PER_US) genOverruns++;
+}
+
+void genTrigger(int trigger, boolean on) {
+  for (int i = 0; i < CC_OUTPUTS; i++) {
+    Generator &gen = generators[i];
+    if (CC_MAP[i][4] != GEN_ENV_MODE || gen.setting[4] != trigger) continue;
+    noInterrupts();
+    if (on) {
+      gen.stage = ENV_ATTACK;
+    } else if (gen.stage != ENV_IDLE) {
+      gen.stage = ENV_RELEASE;
+      gen.releaseStep = genStep(gen.level, gen.setting[3]);
+    }
+    interrupts();
+  }
+}
+
+// Gates of the poly group, from gateOn() and gateOff()
+void genGate(int voice, boolean on) {
+  genTrigger(voice + 1, on);
+  if (on) {
+    genTrigger(0, true);
+    return;
+  }
+  for (int v = 0; v < polycount; v++) {
+    if (v != voice && gateIsOn(v)) return;  // Any gate still held
+  }
+  genTrigger(0, false);
+}
+
+// Notes on the gate channel
+void genNote(byte note, boolean on) {
+  if (note > NO_OF_VOICES) genTrigger(note, on);
+}
+
+// From loop(), follows the clock tempo for the synced LFOs
+void genService() {
+  float bpm = clockBpm();
+  if (bpm == genBpm) return;
+  genBpm = bpm;
+  for (int i = 0; i < CC_OUTPUTS; i++) {
+    if (generators[i].setting[2]) genIncrement(i);
+  }
+}
+
+void genSet(int i, const int *settings) {
+  Generator &gen = generators[i];
+  gen.setting[0] = constrain(settings[0], 0, GEN_TIME_MAX);
+  gen.setting[1] = constrain(settings[1], 0, GEN_TIME_MAX);
+  gen.setting[2] = constrain(settings[2], 0, 100);
+  gen.setting[3] = constrain(settings[3], 0, GEN_TIME_MAX);
+  gen.setting[4] = constrain(settings[4], -100, 127);
+  genPrepare(i);
+}
+
+void genParse(int i, const char *field) {
+  int settings[GEN_SETTINGS] = { 0, 100, 0, 100, 0 };  // 1Hz full range sine
+  sscanf(field, "%d:%d:%d:%d:%d", &settings[0], &settings[1], &settings[2], &settings[3], &settings[4]);
+  genSet(i, settings);
+}
+
+const char *genFormat(int i) {
+  const int16_t *s = generators[i].setting;
+  snprintf(genField, sizeof(genField), "%d:%d:%d:%d:%d", s[0], s[1], s[2], s[3], s[4]);
+  return genField;
+}
+
+void genCommand(const char *args) {
+  int output = 0;
+  int settings[GEN_SETTINGS];
+  if (sscanf(args, "%d %d %d %d %d %d", &output, &settings[0], &settings[1], &settings[2], &settings[3], &settings[4]) == 6 && output >= 1 && output <= CC_OUTPUTS) {
+    genSet(output - 1, settings);
+    if (!genMode(output - 1)) {
+      Serial.print("ch");
+      Serial.print(output);
+      Serial.print(" set to ");
+      Serial.print(genFormat(output - 1));
+      Serial.println(", runs once the output is in LFO or Envelope mode");
+    }
+  } else if (args[0]) {
+    Serial.println("gen <output 1-16> <wave> <rate 0.01Hz> <sync> <level %> <offset %>");
+    Serial.println("gen <output 1-16> <attack ms> <decay ms> <sustain %> <release ms> <trigger>");
+    return;
+  }
+  for (int i = 0; i < CC_OUTPUTS; i++) {
+    const int16_t *s = generators[i].setting;
+    char line[72];
+    if (CC_MAP[i][4] == GEN_LFO_MODE) {
+      snprintf(line, sizeof(line), "ch%d lfo %s %d.%02dHz %s level %d%% offset %d%%", i + 1, LFO_WAVE_NAMES[constrain((int)s[0], 0, LFO_WAVES - 1)],
+               s[1] / 100, s[1] % 100, GEN_SYNC_NAMES[constrain((int)s[2], 0, GEN_SYNCS - 1)], s[3], s[4]);
+    } else if (CC_MAP[i][4] == GEN_ENV_MODE) {
+      snprintf(line, sizeof(line), "ch%d env A %dms D %dms S %d%% R %dms trigger %d", i + 1, s[0], s[1], s[2], s[3], s[4]);
+    } else {
+      continue;
+    }
+    Serial.println(line);
+  }
+  Serial.print("gen tick avg us ");
+  Serial.print(profileAverageUs(PROF_GEN_TICK), 2);
+  Serial.print(" max us ");
+  Serial.print(profileMaxUs(PROF_GEN_TICK), 2);
+  Serial.print(" budget us ");
+  Serial.print(GEN_BUDGET_US);
+  Serial.print(" overruns ");
+  Serial.println(genOverruns);
+}
+
+void setupGenerators() {
+  for (int k = 0; k < 256; k++) {
+    sineTable[k] = 32767 * sinf(k * 2 * PI / 256);
+  }
+  for (int i = 0; i < CC_OUTPUTS; i++) {
+    genParse(i, "");
+  }
+  consoleAppend("gen", "list or set the LFOs and envelopes", genCommand);
+}
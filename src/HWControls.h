@@ -63,6 +63,10 @@
 #define VELOCITY7_LED 30
 #define VELOCITY8_LED 31
 
+uint8_t NOTE_PINS[8] = { NOTE1, NOTE2, NOTE3, NOTE4, NOTE5, NOTE6, NOTE7, NOTE8 };
+uint8_t VELOCITY_PINS[8] = { VELOCITY1, VELOCITY2, VELOCITY3, VELOCITY4, VELOCITY5, VELOCITY6, VELOCITY7, VELOCITY8 };
+uint8_t NOTE_LEDS[8] = { NOTE1_LED, NOTE2_LED, NOTE3_LED, NOTE4_LED, NOTE5_LED, NOTE6_LED, NOTE7_LED, NOTE8_LED };
+
 
 //Encoder or buttons
 #define ENC_A 38
@@ -0,0 +1,61 @@
+/*
+  Heap guard - counts heap allocations on the main loop after setup()
+
+  newlib calls __malloc_lock() on every malloc, realloc and free, so overriding
+  it gives a cheap hook without touching the linker. Once heapGuardArm() has
+  been called at the end of setup(), every heap operation made by the main
+  thread is counted against the loop stage named in heapGuardSection and
+  reported over USB serial. The display thread is not counted.
+
+  Uncomment HEAP_GUARD_TRAP to stop on the first allocation instead. The
+  resulting fault is shown by CrashReport on the next boot.
+*/
+#include "TeensyThreads.h"
+
+//#define HEAP_GUARD_TRAP
+
+volatile boolean heapGuardArmed = false;
+volatile uint8_t heapGuardExempt = 0;
+volatile uint32_t heapGuardCount = 0;
+uint32_t heapGuardReported = 0;
+const char *heapGuardSection = "setup";
+const char *heapGuardLastSection = "";
+
+extern "C" void __malloc_lock(struct _reent *reent) {
+  if (!heapGuardArmed || heapGuardExempt || threads.id() != 0) return;
+  heapGuardCount++;
+  heapGuardLastSection = heapGuardSection;
+#ifdef HEAP_GUARD_TRAP
+  __asm__ volatile("bkpt #0");
+#endif
+}
+
+extern "C" void __malloc_unlock(struct _reent *reent) {
+}
+
+// Allocations made inside the scope of one of these are not counted.
+// Only used for SD library file handles, which are a fixed size and freed
+// again before the call returns.
+struct HeapGuardExempt {
+  HeapGuardExempt() {
+    heapGuardExempt++;
+  }
+  ~HeapGuardExempt() {
+    heapGuardExempt--;
+  }
+};
+
+void heapGuardArm() {
+  heapGuardCount = 0;
+  heapGuardReported = 0;
+  heapGuardArmed = true;
+}
+
+void heapGuardReport() {
+  if (heapGuardCount == heapGuardReported) return;
+  heapGuardReported = heapGuardCount;
+  Serial.print("Heap allocations since setup: ");
+  Serial.print(heapGuardReported);
+  Serial.print(" last in ");
+  Serial.println(heapGuardLastSection);
+}
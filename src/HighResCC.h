@@ -0,0 +1,120 @@
+/*
+  14 bit controllers - CC 0-31 paired with CC 32-63, and NRPN data entry
+
+  A channel output in a CC14 mode listens on its MIDI channel for its CC
+  number as the MSB and that number + 32 as the LSB. The NRPN modes pair
+  data entry MSB (CC6) and LSB (CC38) the same way. The MSB is held until
+  its LSB arrives and then the full 14 bit value is written once. If no LSB
+  arrives within the output's timeout, the MSB is written on its own, for
+  controllers that only send MSB. A timeout of 0 writes every MSB straight
+  away.
+
+  Timeouts are per patch, set with hires <output 1-16> <ms>.
+*/
+
+#define HIRES_TIMEOUT_DEFAULT 5  // ms
+#define HIRES_TIMEOUT_MAX 100
+#define HIRES_FULL_SCALE 16383
+
+uint8_t hiresMsb[CC_OUTPUTS];
+uint32_t hiresTime[CC_OUTPUTS];
+uint16_t hiresPending = 0;  // One bit per output with an MSB waiting for its LSB
+uint8_t hiresTimeout[CC_OUTPUTS];
+uint8_t cc14Msb[16][32];    // Last MSB per channel for the modulation matrix
+uint8_t nrpnParam[16][2];   // CC99 and CC98 per channel
+uint8_t nrpnData[16][2];    // CC6 and CC38 per channel
+char hiresField[4];
+
+uint16_t quantCode(int i, uint16_t value);
+boolean quantMode(int i);
+
+// 14 bit value to PWM code for the output's voltage range, or its note when quantizing
+uint16_t hiresCode(int i, uint16_t value) {
+  if (quantMode(i)) return quantCode(i, value);
+  uint16_t fullScale = (CC_MAP[i][4] & 1) ? 15440 : 7720;  // Odd modes are 0-10V
+  return (uint32_t)value * fullScale / HIRES_FULL_SCALE;
+}
+
+void hiresMsbIn(int i, byte msb) {
+  hiresMsb[i] = msb;
+  if (hiresTimeout[i] == 0) {
+    outputSet(i, hiresCode(i, msb << 7));
+    return;
+  }
+  hiresTime[i] = millis();
+  hiresPending |= 1 << i;
+}
+
+void hiresLsbIn(int i, byte lsb) {
+  hiresPending &= ~(1 << i);
+  outputSet(i, hiresCode(i, (hiresMsb[i] << 7) | lsb));
+}
+
+// Matrix source for 14 bit pairs, updated when the LSB completes the pair
+void cc14In(byte channel, byte number, byte value) {
+  if (channel < 1 || channel > 16) return;
+  if (number < 32) {
+    cc14Msb[channel - 1][number] = value;
+  } else if (number < 64) {
+    modSource(modSlot(MOD_CC14), channel, number - 32, (cc14Msb[channel - 1][number - 32] << 7) | value);
+  }
+}
+
+// Matrix source for NRPN data entry, each channel keeps its own parameter
+// number and data so one channel's bytes never complete another's
+void nrpnIn(byte channel, byte number, byte value) {
+  if (channel < 1 || channel > 16) return;
+  uint8_t *param = nrpnParam[channel - 1];
+  uint8_t *data = nrpnData[channel - 1];
+  if (number == 99) param[0] = value;
+  if (number == 98) param[1] = value;
+  if (number == 6) data[0] = value;
+  if (number == 38) data[1] = value;
+  if (number == 6 || number == 38) {
+    modSource(modSlot(MOD_NRPN), channel, (param[0] << 7) | param[1], (data[0] << 7) | data[1]);
+  }
+}
+
+// From loop() before the output commit, writes MSBs whose LSB never came
+void hiresService() {
+  uint16_t pending = hiresPending;
+  while (pending) {
+    int i = __builtin_ctz(pending);
+    pending &= pending - 1;
+    if (millis() - hiresTime[i] >= hiresTimeout[i]) {
+      hiresPending &= ~(1 << i);
+      outputSet(i, hiresCode(i, hiresMsb[i] << 7));
+    }
+  }
+}
+
+void hiresParse(int i, const char *field) {
+  hiresTimeout[i] = field[0] ? constrain(atoi(field), 0, HIRES_TIMEOUT_MAX) : HIRES_TIMEOUT_DEFAULT;
+}
+
+const char *hiresFormat(int i) {
+  snprintf(hiresField, sizeof(hiresField), "%d", hiresTimeout[i]);
+  return hiresField;
+}
+
+// hires <output 1-16> <ms>, or hires on its own to list the timeouts
+void hiresCommand(const char *args) {
+  int output = 0;
+  int ms = 0;
+  if (sscanf(args, "%d %d", &output, &ms) == 2 && output >= 1 && output <= CC_OUTPUTS) {
+    hiresTimeout[output - 1] = constrain(ms, 0, HIRES_TIMEOUT_MAX);
+  }
+  for (int i = 0; i < CC_OUTPUTS; i++) {
+    Serial.print("ch");
+    Serial.print(i + 1);
+    Serial.print(" msb timeout ms ");
+    Serial.println(hiresTimeout[i]);
+  }
+}
+
+void setupHighResCC() {
+  for (int i = 0; i < CC_OUTPUTS; i++) {
+    hiresTimeout[i] = HIRES_TIMEOUT_DEFAULT;
+  }
+  consoleAppend("hires", "hires <output> <ms> - 14 bit MSB only timeout", hiresCommand);
+}
@@ -0,0 +1,163 @@
+/*
+  Modulation matrix - sources scaled, offset and summed onto any output
+
+  A route takes a source (a CC, a 14 bit CC pair, an NRPN, velocity, note
+  number, pitch bend or channel aftertouch) on one MIDI channel, or all when channel is 0,
+  scales it by -100..100% and adds -100..100% of full scale. Every route to
+  the same output is summed and clamped to the 14 bit PWM range. An output
+  with any route is owned by the matrix, so the fixed CC, bend, wheel,
+  breath and aftertouch routing to it is ignored.
+
+  Routes are stored in the patch, one field each, as
+  source:channel:param:output:scale:offset
+  When a patch loads they are compiled into a fan-out table indexed by
+  source slot (CC number, or one slot per other source), so a message only
+  walks the routes it drives. Each route keeps its last contribution and
+  the output sum is updated by the difference.
+
+  Console: mod lists the routes, mod <route> <source> <channel> <param>
+  <output> <scale> <offset> sets one, mod <route> off clears it.
+*/
+
+#define MOD_ROUTES 16
+#define MOD_FULL_SCALE 16383
+
+#define MOD_NONE 0
+#define MOD_CC 1
+#define MOD_NRPN 2
+#define MOD_VELOCITY 3
+#define MOD_NOTE 4
+#define MOD_BEND 5
+#define MOD_AFTERTOUCH 6
+#define MOD_CC14 7
+#define MOD_SOURCES 8
+
+#define MOD_SLOTS (128 + MOD_SOURCES)  // One slot per CC number, then one per other source
+#define modSlot(source) (128 + (source))
+
+const char *MOD_SOURCE_NAMES[MOD_SOURCES] = { "off", "cc", "nrpn", "vel", "note", "bend", "at", "cc14" };
+const char *OUTPUT_NAMES[OUTPUTS] = { "ch1", "ch2", "ch3", "ch4", "ch5", "ch6", "ch7", "ch8",
+                                      "ch9", "ch10", "ch11", "ch12", "ch13", "ch14", "ch15", "ch16",
+                                      "bend", "wheel", "at", "breath" };
+
+struct ModRoute {
+  uint8_t source;
+  uint8_t channel;
+  uint16_t param;
+  uint8_t output;
+  int8_t scale;
+  int8_t offset;
+  int32_t contribution;
+};
+
+ModRoute modRoutes[MOD_ROUTES];
+uint8_t modStart[MOD_SLOTS + 1];  // Fan-out table, routes for slot s are modIndex[modStart[s]..modStart[s + 1]]
+uint8_t modIndex[MOD_ROUTES];
+int32_t modSum[OUTPUTS];
+char modField[PATCH_FIELD_SIZE];
+
+int modSourceSlot(const ModRoute &route) {
+  return route.source == MOD_CC ? route.param & 0x7F : modSlot(route.source);
+}
+
+void modCompile() {
+  memset(modStart, 0, sizeof(modStart));
+  memset(modSum, 0, sizeof(modSum));
+  outputMatrix = 0;
+  for (int r = 0; r < MOD_ROUTES; r++) {
+    ModRoute &route = modRoutes[r];
+    if (route.source == MOD_NONE) continue;
+    modStart[modSourceSlot(route) + 1]++;
+    route.contribution = route.offset * MOD_FULL_SCALE / 100;
+    modSum[route.output] += route.contribution;
+    outputMatrix |= 1UL << route.output;
+  }
+  for (int s = 0; s < MOD_SLOTS; s++) {
+    modStart[s + 1] += modStart[s];
+  }
+  uint8_t fill[MOD_SLOTS];
+  memcpy(fill, modStart, sizeof(fill));
+  for (int r = 0; r < MOD_ROUTES; r++) {
+    if (modRoutes[r].source == MOD_NONE) continue;
+    modIndex[fill[modSourceSlot(modRoutes[r])]++] = r;
+  }
+  for (int out = 0; out < OUTPUTS; out++) {
+    if (outputMatrix & (1UL << out)) outputSetMatrix(out, constrain(modSum[out], 0, MOD_FULL_SCALE));
+  }
+}
+
+// value is 0..16383, or -8192..8191 for pitch bend
+void modSource(int slot, byte channel, uint16_t param, int32_t value) {
+  for (int k = modStart[slot]; k < modStart[slot + 1]; k++) {
+    ModRoute &route = modRoutes[modIndex[k]];
+    if (route.channel && route.channel != channel) continue;
+    if ((route.source == MOD_NRPN || route.source == MOD_CC14) && route.param != param) continue;
+    int32_t contribution = value * route.scale / 100 + route.offset * MOD_FULL_SCALE / 100;
+    modSum[route.output] += contribution - route.contribution;
+    route.contribution = contribution;
+    outputSetMatrix(route.output, constrain(modSum[route.output], 0, MOD_FULL_SCALE));
+  }
+}
+
+void modParse(int r, const char *field) {
+  ModRoute &route = modRoutes[r];
+  char *end;
+  route.source = strtol(field, &end, 10);
+  route.channel = *end == ':' ? strtol(end + 1, &end, 10) : 0;
+  route.param = *end == ':' ? strtol(end + 1, &end, 10) : 0;
+  route.output = *end == ':' ? strtol(end + 1, &end, 10) : 0;
+  route.scale = *end == ':' ? constrain((int)strtol(end + 1, &end, 10), -100, 100) : 0;
+  route.offset = *end == ':' ? constrain((int)strtol(end + 1, &end, 10), -100, 100) : 0;
+  if (route.source >= MOD_SOURCES || route.output >= OUTPUTS) route.source = MOD_NONE;
+}
+
+// Route r as a patch field, empty when unused
+const char *modFormat(int r) {
+  const ModRoute &route = modRoutes[r];
+  modField[0] = 0;
+  if (route.source != MOD_NONE) {
+    snprintf(modField, sizeof(modField), "%d:%d:%d:%d:%d:%d", route.source, route.channel, route.param,
+             route.output, route.scale, route.offset);
+  }
+  return modField;
+}
+
+int modFindName(const char *name, const char *const *names, int count) {
+  for (int i = 0; i < count; i++) {
+    if (strcmp(name, names[i]) == 0) return i;
+  }
+  return -1;
+}
+
+void modCommand(const char *args) {
+  char source[8] = "";
+  char output[8] = "";
+  int r = 0, channel = 0, param = 0, scale = 100, offset = 0;
+  int n = sscanf(args, "%d %7s %d %d %7s %d %d", &r, source, &channel, &param, output, &scale, &offset);
+  if (n >= 2 && r >= 1 && r <= MOD_ROUTES) {
+    int s = modFindName(source, MOD_SOURCE_NAMES, MOD_SOURCES);
+    int out = modFindName(output, OUTPUT_NAMES, OUTPUTS);
+    if (s == MOD_NONE) {
+      modRoutes[r - 1].source = MOD_NONE;
+    } else if (n >= 5 && s > 0 && out >= 0) {
+      modRoutes[r - 1] = { (uint8_t)s, (uint8_t)channel, (uint16_t)param, (uint8_t)out,
+                           (int8_t)constrain(scale, -100, 100), (int8_t)constrain(offset, -100, 100), 0 };
+    } else {
+      Serial.println("mod <route 1-16> <off|cc|nrpn|vel|note|bend|at|cc14> <channel, 0 all> <param> <output> [scale %] [offset %]");
+      return;
+    }
+    modCompile();
+  }
+  for (int i = 0; i < MOD_ROUTES; i++) {
+    const ModRoute &route = modRoutes[i];
+    if (route.source == MOD_NONE) continue;
+    char line[64];
+    snprintf(line, sizeof(line), "%2d %-4s ch %2d param %5d -> %-6s %4d%% %+4d%%", i + 1, MOD_SOURCE_NAMES[route.source],
+             route.channel, route.param, OUTPUT_NAMES[route.output], route.scale, route.offset);
+    Serial.println(line);
+  }
+}
+
+void setupModMatrix() {
+  consoleAppend("mod", "list or set modulation routes", modCommand);
+}
@@ -0,0 +1,232 @@
+/*
+  MPE zone - one note per member channel, each with its own bend and pressure
+
+  With a zone set and the key mode on Poly (not chained), notes on the zone's
+  member channels take a voice from the normal allocator and the channel is
+  bound to that voice. The lower zone's master is channel 1 with members
+  counting up from 2, the upper zone's master is 16 with members counting
+  down from 15, MPE Members channels of them. An MPE Configuration Message
+  (RPN 6) on the master channel sets the count too. The gate channel and
+  the channels the channel outputs listen on are never members, so their
+  notes and controllers are handled as before. The master channel bends
+  every voice through the patch bend range, and is otherwise handled as
+  before when it is the MIDI channel.
+
+  Per note bend on a member channel is summed into its voice's pitch over the
+  MPE default of 48 semitones. Channel pressure or CC74 timbre, as set, goes
+  to the voice's velocity output after the note's velocity. Member channel
+  messages are looked up through a channel to voice table, so each one costs
+  the same however many notes are held.
+
+  mpe shows the bindings and handler times, mpe bench runs MPE_BENCH_ROUNDS
+  of bend, pressure and timbre messages through the handlers on each bound
+  channel and prints the time per message.
+*/
+
+#define MPE_OFF 0
+#define MPE_LOWER 1
+#define MPE_UPPER 2
+
+#define MPE_PRESSURE 0
+#define MPE_TIMBRE 1
+
+#define MPE_BEND_RANGE 48  // Semitones, the MPE default for member channels
+#define MPE_BEND_CODES (int32_t)(MPE_BEND_RANGE * NOTE_SF)
+#define MPE_TIMBRE_CC 74
+#define MPE_MEMBERS_MAX 15
+#define MPE_RPN_MCM 6  // MPE Configuration Message
+#define MPE_BENCH_ROUNDS 1000
+
+void voiceNoteOn(int voice, byte note, byte velocity);
+void voiceNoteOff(int voice);
+void myPitchBend(byte channel, int bend);
+void myAfterTouch(byte channel, byte value);
+void myControlChange(byte channel, byte number, byte value);
+
+int mpeZone = MPE_OFF;              // (EEPROM)
+int mpeExpression = MPE_PRESSURE;   // (EEPROM)
+int mpeMembers = MPE_MEMBERS_MAX;   // (EEPROM)
+uint8_t mpeRpn[2] = { 0x7F, 0x7F }; // CC101 and CC100 on the master channel
+int8_t mpeChannelVoice[17];         // Voice bound to each channel, -1 for none
+int8_t mpeVoiceChannel[NO_OF_VOICES];
+int mpeChannelBend[17];             // Last bend per channel, sent before the note in MPE
+uint32_t mpeMessages = 0;
+
+boolean mpeActive() {
+  return mpeZone != MPE_OFF && keyboardMode == 0 && chainMode == CHAIN_OFF;
+}
+
+byte mpeMaster() {
+  return mpeZone == MPE_UPPER ? 16 : 1;
+}
+
+// A channel output on a CC mode listens on its own MIDI channel
+boolean mpeOutputChannel(byte channel) {
+  for (int i = 0; i < 16; i++) {
+    if (CC_MAP[i][2] == 0 && CC_MAP[i][4] >= 2 && CC_MAP[i][4] <= QUANT_CC14_MODE && CC_MAP[i][1] == channel) return true;
+  }
+  return false;
+}
+
+boolean mpeMember(byte channel) {
+  if (!mpeActive()) return false;
+  int offset = mpeZone == MPE_UPPER ? 16 - channel : channel - 1;
+  if (offset < 1 || offset > mpeMembers) return false;
+  return channel != gateChannel && !mpeOutputChannel(channel);
+}
+
+void mpeUnbind(int voice) {
+  int8_t channel = mpeVoiceChannel[voice];
+  if (channel > 0) mpeChannelVoice[channel] = -1;
+  mpeVoiceChannel[voice] = 0;
+}
+
+// Each of these returns true when the message was for a member channel
+boolean mpeNoteOff(byte channel, byte note) {
+  if (!mpeMember(channel)) return false;
+  int voice = mpeChannelVoice[channel];
+  if (voice >= 0 && voices[voice].note == note) {
+    voiceNoteOff(voice);
+    mpeUnbind(voice);
+  }
+  return true;
+}
+
+boolean mpeNoteOn(byte channel, byte note, byte velocity) {
+  if (!mpeMember(channel)) return false;
+  if (velocity == 0) return mpeNoteOff(channel, note);
+  int voice = mpeChannelVoice[channel];
+  if (voice < 0) {
+    voice = allocVoice(note);
+    mpeUnbind(voice);  // Stolen from another channel
+    mpeChannelVoice[channel] = voice;
+    mpeVoiceChannel[voice] = channel;
+  }
+  setVoiceBend(voice, mpeChannelBend[channel] * MPE_BEND_CODES / 8192);
+  voiceNoteOn(voice, note, velocity);
+  return true;
+}
+
+boolean mpePitchBend(byte channel, int bend) {
+  if (!mpeActive()) return false;
+  if (channel == mpeMaster()) {
+    setPitchBend(bend);
+    return false;
+  }
+  if (!mpeMember(channel)) return false;
+  mpeMessages++;
+  mpeChannelBend[channel] = bend;
+  int voice = mpeChannelVoice[channel];
+  if (voice >= 0) setVoiceBend(voice, bend * MPE_BEND_CODES / 8192);
+  return true;
+}
+
+boolean mpeExpressionIn(byte channel, int type, byte value) {
+  if (!mpeMember(channel)) return false;
+  mpeMessages++;
+  int voice = mpeChannelVoice[channel];
+  if (voice >= 0 && type == mpeExpression) velocitySet(voice, curveCode(CURVE_VELOCITY, value, 8191));
+  return true;
+}
+
+void mpeReset() {
+  for (int channel = 0; channel <= 16; channel++) {
+    mpeChannelVoice[channel] = -1;
+    mpeChannelBend[channel] = 0;
+  }
+  for (int voice = 0; voice < NO_OF_VOICES; voice++) {
+    mpeVoiceChannel[voice] = 0;
+    setVoiceBend(voice, 0);
+  }
+}
+
+void setMpeZone(int zone) {
+  mpeZone = zone;
+  allNotesOff();
+  storeMpeZone(zone);
+}
+
+void setMpeMembers(int members) {
+  mpeMembers = constrain(members, 0, MPE_MEMBERS_MAX);
+  allNotesOff();
+  storeMpeMembers(mpeMembers);
+}
+
+// RPN 6 on the master channel sets the member count, data entry MSB only
+void mpeConfigIn(byte channel, byte number, byte value) {
+  if (mpeZone == MPE_OFF || channel != mpeMaster()) return;
+  if (number == 101) mpeRpn[0] = value;
+  if (number == 100) mpeRpn[1] = value;
+  if (number == 6 && mpeRpn[0] == 0 && mpeRpn[1] == MPE_RPN_MCM && value != mpeMembers) setMpeMembers(value);
+}
+
+void setMpeExpression(int expression) {
+  mpeExpression = expression;
+  storeMpeExpression(expression);
+}
+
+void mpeBench() {
+  uint32_t start = PROFILE_NOW();
+  uint32_t sent = 0;
+  for (int n = 0; n < MPE_BENCH_ROUNDS; n++) {
+    for (byte channel = 1; channel <= 16; channel++) {
+      if (mpeChannelVoice[channel] < 0) continue;
+      myPitchBend(channel, (n * 37) % 1024 - 512);
+      myAfterTouch(channel, n & 0x7F);
+      myControlChange(channel, MPE_TIMBRE_CC, n & 0x7F);
+      sent += 3;
+    }
+  }
+  uint32_t ticks = PROFILE_NOW() - start;
+  for (byte channel = 1; channel <= 16; channel++) {
+    if (mpeChannelVoice[channel] >= 0) myPitchBend(channel, 0);
+  }
+  if (sent == 0) {
+    Serial.println("mpe bench needs held notes on member channels");
+    return;
+  }
+  Serial.print("mpe bench messages ");
+  Serial.print(sent);
+  Serial.print(" us per message ");
+  Serial.println((float)ticks / PROFILE_TICKS_PER_US / sent, 2);
+}
+
+void mpeCommand(const char *args) {
+  if (strncmp(args, "bench", 5) == 0) {
+    mpeBench();
+    return;
+  }
+  Serial.print("mpe zone ");
+  Serial.print(mpeZone == MPE_LOWER ? "lower" : mpeZone == MPE_UPPER ? "upper" : "off");
+  Serial.print(mpeActive() ? "" : " (inactive)");
+  Serial.print(" members ");
+  Serial.print(mpeMembers);
+  Serial.print(" messages ");
+  Serial.println(mpeMessages);
+  for (byte channel = 1; channel <= 16; channel++) {
+    int voice = mpeChannelVoice[channel];
+    if (voice < 0) continue;
+    Serial.print("ch");
+    Serial.print(channel);
+    Serial.print(" -> voice ");
+    Serial.print(voice + 1);
+    Serial.print(" note ");
+    Serial.print(voices[voice].note);
+    Serial.print(" bend ");
+    Serial.println(mpeChannelBend[channel]);
+  }
+  Serial.print("bend avg us ");
+  Serial.print(profileAverageUs(PROF_PITCH_BEND), 2);
+  Serial.print(" pressure avg us ");
+  Serial.print(profileAverageUs(PROF_AFTERTOUCH), 2);
+  Serial.print(" cc avg us ");
+  Serial.println(profileAverageUs(PROF_CONTROL_CHANGE), 2);
+}
+
+void setupMpeZone() {
+  mpeZone = getMpeZone();
+  mpeExpression = getMpeExpression();
+  mpeMembers = getMpeMembers();
+  mpeReset();
+  consoleAppend("mpe", "mpe zone bindings, mpe bench to time the handlers", mpeCommand);
+}
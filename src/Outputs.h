@@ -0,0 +1,118 @@
+/*
+  Output commit - last value wins for CC driven outputs and activity LEDs
+
+  Handlers don't write the PWM outputs driven by controllers or the activity
+  LEDs directly. They put the value in a pending slot and commitOutputs(),
+  which runs once per loop pass after the MIDI reads, writes each output that
+  changed. A burst of CCs for the same output costs one write, and a value the
+  output already has costs none. LEDs are set in the shift register without
+  shifting out, then updated in a single shift.
+
+  Slots 0-15 are the channel outputs in CC_MAP order, which ramp through the
+  control engine. Then come the fixed pitch bend, mod wheel, aftertouch and
+  breath outputs. Outputs driven by the modulation matrix ignore outputSet()
+  and are only written through outputSetMatrix().
+
+  The last 8 slots are the voice velocity outputs, for pressure after the
+  note on. They're written on every commit that has them pending, as the
+  note on velocity goes straight out with the gate through velocityWrite(),
+  which also drops any pressure still pending for the voice.
+*/
+
+boolean quantMode(int i);
+
+#define OUT_PITCHBEND 16
+#define OUT_WHEEL 17
+#define OUT_AFTERTOUCH 18
+#define OUT_BREATH 19
+#define OUTPUTS 20
+#define VELOCITY_SLOT 20
+#define OUTPUT_SLOTS (VELOCITY_SLOT + NO_OF_VOICES)
+
+const uint8_t FIXED_OUTPUT_PINS[OUTPUTS - CC_OUTPUTS] = { PITCHBEND, WHEEL, AFTERTOUCH, BREATH };
+
+uint16_t outputPending[OUTPUT_SLOTS];
+uint16_t outputLast[OUTPUTS];
+uint32_t outputDirty = 0;  // One bit per slot
+uint32_t ledPending = 0;   // One bit per shift register output
+uint32_t outputMatrix = 0; // One bit per slot owned by the modulation matrix
+
+void outputSetMatrix(int out, uint16_t code) {
+  outputPending[out] = code;
+  outputDirty |= 1UL << out;
+}
+
+void outputSet(int out, uint16_t code) {
+  if (outputMatrix & (1UL << out)) return;
+  outputSetMatrix(out, code);
+}
+
+// Voice velocity from pressure, the last one before the commit wins
+void velocitySet(int voice, uint16_t code) {
+  outputSetMatrix(VELOCITY_SLOT + voice, code);
+}
+
+void velocityWrite(int voice, uint16_t code) {
+  outputDirty &= ~(1UL << (VELOCITY_SLOT + voice));
+  pwmWrite(VELOCITY_PINS[voice], code);
+}
+
+// Lights an activity LED on the next commit
+void ledSet(uint8_t led) {
+  ledPending |= 1UL << led;
+}
+
+void commitOutputs() {
+  uint32_t dirty = outputDirty;
+  outputDirty = 0;
+  while (dirty) {
+    int out = __builtin_ctz(dirty);
+    dirty &= dirty - 1;
+    if (out >= VELOCITY_SLOT) {
+      outputWrites++;
+      pwmWrite(VELOCITY_PINS[out - VELOCITY_SLOT], outputPending[out]);
+      continue;
+    }
+    if (out < CC_OUTPUTS && CC_MAP[out][2]) continue;  // Pin is a voice in this poly count
+    uint16_t code = outputPending[out];
+    if (code == outputLast[out]) {
+      outputSkips++;
+      continue;
+    }
+    outputLast[out] = code;
+    outputWrites++;
+    if (out < CC_OUTPUTS && quantMode(out)) {
+      ccJumpTo(out, code);
+    } else if (out < CC_OUTPUTS) {
+      ccSlewTo(out, code);
+    } else {
+      pwmWrite(FIXED_OUTPUT_PINS[out - CC_OUTPUTS], code);
+    }
+  }
+
+  uint32_t leds = ledPending;
+  ledPending = 0;
+  boolean changed = false;
+  noInterrupts();
+  while (leds) {
+    int led = __builtin_ctz(leds);
+    leds &= leds - 1;
+    if (sr.get(led)) continue;
+    sr.setNoUpdate(led, HIGH);
+    changed = true;
+  }
+  if (changed) sr.updateRegisters();
+  interrupts();
+}
+
+// The channel outputs move between pins when the poly count changes
+void invalidateOutputs() {
+  for (int i = 0; i < CC_OUTPUTS; i++) {
+    outputLast[i] = 0xFFFF;
+  }
+}
+
+void setupOutputs() {
+  invalidateOutputs();
+  outputLast[OUT_PITCHBEND] = 1543;  // Centre, as written in setupHardware()
+}
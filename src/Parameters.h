@@ -1,6 +1,3 @@
-static unsigned long clock_timer = 0, clock_timeout = 0;
-static unsigned int clock_count = 0;
-
 static unsigned long pitchbend_timer = 0;
 static unsigned long mod_timer = 0;
 static unsigned long aftertouch_timer = 0;
@@ -52,12 +49,6 @@ int param_change = 0;
 boolean paramEdit = false;
 boolean SetTempoActive = true;
 boolean paramChange = false;
-uint16_t Clock; 
-
-int value99;
-int value98;
-int value6;
-int value38;
 
 unsigned int mV1;
 unsigned int mV2;
@@ -72,6 +63,9 @@ unsigned int mV8;
 byte midiChannel = 1;//(EEPROM)
 byte gateChannel = 2;//(EEPROM)
 int freeGates = 0;
+int chainMode = 0;//0 = Off, 1 = Leader, 2/3 = Follower 1/2 (EEPROM)
+int chainUnits = 1;//Units in the chain including the leader (EEPROM)
+int displaySlice = 2;//ms the display thread may hold the CPU for (EEPROM)
 
 int polycount = 0;
 int channel1 = 0;
@@ -145,5 +139,6 @@ int eepromOctave;
 int oldeepromOctave;
 int realoctave;
 int keyboardMode = 0;
+int polyAtMode = 0;  // 0 = Off, 1 = voice velocity outputs, 2-17 = channel output 1-16 (patch)
 
 int returnvalue = 0;
@@ -21,6 +21,9 @@
 #include <CircularBuffer.h>
 
 #define TOTALCHARS 63
+#define PATCH_NAME_SIZE 14   // 13 characters and zero byte
+#define PATCH_FIELD_SIZE 28  // Must hold longest field with delimiter and zero byte
+#define PATCH_DATA_SIZE (NO_OF_PARAMS * PATCH_FIELD_SIZE)
 
 const char CHARACTERS[TOTALCHARS] = {'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z', 'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z', ' ', '1', '2', '3', '4', '5', '6', '7', '8', '9', '0'};
 int charIndex = 0;
@@ -30,11 +33,49 @@ String renamedPatch = "";
 struct PatchNoAndName
 {
   int patchNo;
-  String patchName;
+  char patchName[PATCH_NAME_SIZE];
 };
 
 CircularBuffer<PatchNoAndName, PATCHES_LIMIT> patches;
 
+//Patch fields are read into and written from these instead of Strings
+char patchFields[NO_OF_PARAMS][PATCH_FIELD_SIZE];
+char patchLine[PATCH_DATA_SIZE];
+char patchFileName[8];
+
+PatchNoAndName patchEntry(int patchNo, const char *patchName)
+{
+  PatchNoAndName entry;
+  entry.patchNo = patchNo;
+  strlcpy(entry.patchName, patchName, PATCH_NAME_SIZE);
+  return entry;
+}
+
+const char *patchFileNameFor(int patchNo)
+{
+  snprintf(patchFileName, sizeof(patchFileName), "%d", patchNo);
+  return patchFileName;
+}
+
+// The SD library allocates a small handle for every open file and frees it on close
+File patchOpen(const char *name, uint8_t mode = FILE_READ)
+{
+  HeapGuardExempt exempt;
+  return SD.open(name, mode);
+}
+
+File patchOpenNext(File &dir)
+{
+  HeapGuardExempt exempt;
+  return dir.openNextFile();
+}
+
+void patchClose(File &file)
+{
+  HeapGuardExempt exempt;
+  file.close();
+}
+
 size_t readField(File *file, char *str, size_t size, const char *delim)
 {
   char ch;
@@ -56,15 +97,20 @@ size_t readField(File *file, char *str, size_t size, const char *delim)
   return n;
 }
 
-void recallPatchData(File patchFile, String data[])
+void recallPatchData(File &patchFile, char data[][PATCH_FIELD_SIZE])
 {
   //Read patch data from file and set current patch parameters
   size_t n;     // Length of returned field with delimiter.
-  char str[20]; // Must hold longest field with delimiter and zero byte.
+  char *str;
   int i = 0;
+  for (int j = 0; j < NO_OF_PARAMS; j++)
+  {
+    data[j][0] = 0;
+  }
   while (patchFile.available() && i < NO_OF_PARAMS)
   {
-    n = readField(&patchFile, str, sizeof(str), ",\n");
+    str = data[i];
+    n = readField(&patchFile, str, PATCH_FIELD_SIZE, ",\n");
     // done if Error or at EOF.
     if (n == 0)
       break;
@@ -83,7 +129,7 @@ void recallPatchData(File patchFile, String data[])
     //    Serial.print(i);
     //    Serial.print(" - ");
     //    Serial.println(str);
-    data[i++] = String(str);
+    i++;
   }
 }
 
@@ -112,12 +158,11 @@ void sortPatches()
 
 void loadPatches()
 {
-  File file = SD.open("/");
+  File file = patchOpen("/");
   patches.clear();
   while (true)
   {
-    String data[NO_OF_PARAMS]; //Array of data read in
-    File patchFile = file.openNextFile();
+    File patchFile = patchOpenNext(file);
     if (!patchFile)
     {
       break;
@@ -128,16 +173,19 @@ void loadPatches()
     }
     else
     {
-      recallPatchData(patchFile, data);
-      patches.push(PatchNoAndName{atoi(patchFile.name()), data[0]});
-      Serial.println(String(patchFile.name()) + ":" + data[0]);
+      recallPatchData(patchFile, patchFields);
+      patches.push(patchEntry(atoi(patchFile.name()), patchFields[0]));
+      Serial.print(patchFile.name());
+      Serial.print(":");
+      Serial.println(patchFields[0]);
     }
-    patchFile.close();
+    patchClose(patchFile);
   }
+  patchClose(file);
   sortPatches();
 }
 
-void savePatch(const char *patchNo, String patchData)
+void savePatch(const char *patchNo, const char *patchData)
 {
   // Serial.print("savePatch Patch No:");
   //  Serial.println(patchNo);
@@ -146,14 +194,14 @@ void savePatch(const char *patchNo, String patchData)
   {
     SD.remove(patchNo);
   }
-  File patchFile = SD.open(patchNo, FILE_WRITE);
+  File patchFile = patchOpen(patchNo, FILE_WRITE);
   if (patchFile)
   {
     //    Serial.print("Writing Patch No:");
     //    Serial.println(patchNo);
     //Serial.println(patchData);
     patchFile.println(patchData);
-    patchFile.close();
+    patchClose(patchFile);
   }
   else
   {
@@ -162,14 +210,15 @@ void savePatch(const char *patchNo, String patchData)
   }
 }
 
-void savePatch(const char *patchNo, String patchData[])
+void savePatch(const char *patchNo, char patchData[][PATCH_FIELD_SIZE])
 {
-  String dataString = patchData[0];
+  strlcpy(patchLine, patchData[0], PATCH_DATA_SIZE);
   for (int i = 1; i < NO_OF_PARAMS; i++)
   {
-    dataString = dataString + "," + patchData[i];
+    strlcat(patchLine, ",", PATCH_DATA_SIZE);
+    strlcat(patchLine, patchData[i], PATCH_DATA_SIZE);
   }
-  savePatch(patchNo, dataString);
+  savePatch(patchNo, patchLine);
 }
 
 void deletePatch(const char *patchNo)
@@ -178,17 +227,18 @@ void deletePatch(const char *patchNo)
 }
 
 void renumberPatchesOnSD() {
+  char newPatchNo[8];
   for (int i = 0; i < patches.size(); i++)
   {
-    String data[NO_OF_PARAMS]; //Array of data read in
-    File file = SD.open(String(patches[i].patchNo).c_str());
+    File file = patchOpen(patchFileNameFor(patches[i].patchNo));
     if (file) {
-      recallPatchData(file, data);
-      file.close();
-      savePatch(String(i + 1).c_str(), data);
+      recallPatchData(file, patchFields);
+      patchClose(file);
+      snprintf(newPatchNo, sizeof(newPatchNo), "%d", i + 1);
+      savePatch(newPatchNo, patchFields);
     }
   }
-  deletePatch(String(patches.size() + 1).c_str()); //Delete final patch which is duplicate of penultimate patch
+  deletePatch(patchFileNameFor(patches.size() + 1)); //Delete final patch which is duplicate of penultimate patch
 }
 
 void setPatchesOrdering(int no) {
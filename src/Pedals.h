@@ -0,0 +1,89 @@
+/*
+  Sustain and sostenuto pedals - deferred note offs for the poly voices
+
+  In Poly mode a note off while the sustain pedal (CC64) is down, or for a
+  voice the sostenuto pedal (CC66) caught, doesn't release the voice. The
+  voice goes into a release set, one bit per voice, and keeps sounding.
+  Lifting the pedal releases the whole set in one pass: the voices are freed,
+  then all their gates and note LEDs go low in a single shift register
+  update, however big the chord.
+
+  Sostenuto catches the voices sounding when it goes down, sustained ones
+  included. A sustained voice that plays a new note leaves the set, and
+  when there are no free voices the oldest sustained one is stolen first.
+*/
+
+#define PEDAL_CC_SUSTAIN 64
+#define PEDAL_CC_SOSTENUTO 66
+
+void voiceRelease(int voice);
+
+boolean sustainDown = false;
+boolean sostenutoDown = false;
+uint8_t pedalReleased = 0;  // Voices whose key is up but a pedal holds them
+uint8_t sostenutoHeld = 0;  // Voices caught by the sostenuto pedal
+
+// From the poly note off, true when a pedal holds the voice
+boolean pedalHold(int voice) {
+  uint8_t bit = 1 << voice;
+  if (!sustainDown && !(sostenutoHeld & bit)) return false;
+  pedalReleased |= bit;
+  return true;
+}
+
+// A voice taking a new note is no longer held
+void pedalClear(int voice) {
+  uint8_t bit = 1 << voice;
+  pedalReleased &= ~bit;
+  sostenutoHeld &= ~bit;
+}
+
+void pedalFlush(uint8_t release) {
+  if (!release) return;
+  pedalReleased &= ~release;
+  sostenutoHeld &= ~release;
+  uint8_t pending = release;
+  while (pending) {
+    int voice = __builtin_ctz(pending);
+    pending &= pending - 1;
+    voiceRelease(voice);
+  }
+  gatesOff(release);
+}
+
+void setSustain(boolean down) {
+  if (down == sustainDown) return;
+  sustainDown = down;
+  if (!down) pedalFlush(pedalReleased & ~sostenutoHeld);
+}
+
+void setSostenuto(boolean down) {
+  if (down == sostenutoDown) return;
+  sostenutoDown = down;
+  if (down) {
+    for (int voice = 0; voice < polycount; voice++) {
+      if (voiceOn[voice]) sostenutoHeld |= 1 << voice;
+    }
+  } else {
+    uint8_t held = sostenutoHeld;
+    sostenutoHeld = 0;
+    if (!sustainDown) pedalFlush(pedalReleased & held);
+  }
+}
+
+// Oldest voice a pedal is holding, -1 for none
+int pedalOldest() {
+  int oldest = -1;
+  uint8_t held = pedalReleased;
+  while (held) {
+    int voice = __builtin_ctz(held);
+    held &= held - 1;
+    if (voice < polycount && (oldest < 0 || voices[voice].timeOn < voices[oldest].timeOn)) oldest = voice;
+  }
+  return oldest;
+}
+
+void pedalReset() {
+  pedalReleased = 0;
+  sostenutoHeld = 0;
+}
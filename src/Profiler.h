@@ -0,0 +1,219 @@
+/*
+  Profiler - cycle counts for each loop() stage and MIDI handler
+
+  On the Teensy the ARM DWT cycle counter is used, elsewhere micros() stands in
+  so the same counters work with any timer. Each stage keeps min/avg/max and a
+  histogram with power of two microsecond buckets (<1us, <2us ... >=1ms).
+  Messages per second are counted per MIDI port, along with the number of
+  times the DIN receive buffer was found full, which is when bytes get dropped.
+  The gap between MIDI polls is the worst case wait for a note, and is kept
+  apart for the passes where the display thread had the CPU. Gate late is how
+  far behind its due time each scheduled gate write was made. Clock jitter is
+  how far each MIDI clock tick was from the tracked period, clock lock the
+  time taken to lock on to a new tempo, int jitter how far each internal clock
+  tick was from its period.
+
+  Hold Settings to show the stats page, turn the encoder to change page.
+  Type "stats" on the USB serial port for the full dump, "reset" to clear.
+*/
+
+#if defined(ARM_DWT_CYCCNT)
+#define PROFILE_NOW() ARM_DWT_CYCCNT
+#define PROFILE_TICKS_PER_US (F_CPU_ACTUAL / 1000000)
+#else
+#define PROFILE_NOW() micros()
+#define PROFILE_TICKS_PER_US 1
+#endif
+
+#define PROFILE_BUCKETS 12
+#define PROFILE_DIN_RX_FULL 63  // Serial1 has a 64 byte receive buffer
+#define STATS_LINES 8
+#define STATS_STAGE_PAGES ((PROF_MIDI_GAP + STATS_LINES - 1) / STATS_LINES)
+#define STATS_PAGES (STATS_STAGE_PAGES + 2)  // Then the ports page and the clock page
+
+enum ProfileStages {
+  PROF_SWITCHES,
+  PROF_DRUM_ENCODER,
+  PROF_ENCODER,
+  PROF_USB_TASK,
+  PROF_READ_HOST,
+  PROF_READ_DIN,
+  PROF_READ_USB,
+  PROF_LEDS_OFF,
+  PROF_COMMIT,
+  PROF_LOOP,
+  PROF_NOTE_ON,
+  PROF_NOTE_OFF,
+  PROF_CONTROL_CHANGE,
+  PROF_PITCH_BEND,
+  PROF_AFTERTOUCH,
+  PROF_POLY_AFTERTOUCH,
+  PROF_CLOCK,
+  PROF_TRANSPORT,
+  PROF_MIDI_GAP,
+  PROF_MIDI_GAP_DISPLAY,
+  PROF_GATE_LATE,
+  PROF_CLOCK_JITTER,
+  PROF_CLOCK_LOCK,
+  PROF_MASTER_JITTER,
+  PROF_CONTROL_TICK,
+  PROF_GEN_TICK,
+  PROF_SEQ_JITTER,
+  PROF_ALLOC,
+  PROF_STAGES
+};
+
+#define PROF_FIRST_HANDLER PROF_NOTE_ON
+
+enum ProfilePorts {
+  PORT_HOST,
+  PORT_DIN,
+  PORT_USB,
+  PROFILE_PORTS
+};
+
+struct ProfileStat {
+  uint32_t min;
+  uint32_t max;
+  uint32_t count;
+  uint64_t total;
+  uint32_t hist[PROFILE_BUCKETS];
+};
+
+const char *PROFILE_NAMES[PROF_STAGES] = {
+  "switches", "drum enc", "encoder", "usb task", "read host", "read din", "read usb", "leds off", "commit", "loop",
+  "note on", "note off", "cc", "bend", "aftertouch", "poly at", "clock", "transport", "midi gap", "gap+disp", "gate late", "clk jitter", "clk lock", "int jitter", "ctl tick", "gen tick", "seq jitter", "alloc"
+};
+const char *PORT_NAMES[PROFILE_PORTS] = { "host", "din", "usb" };
+
+ProfileStat profileStats[PROF_STAGES];
+volatile uint32_t portMessages[PROFILE_PORTS];
+uint32_t portRate[PROFILE_PORTS];
+uint32_t portLast[PROFILE_PORTS];
+uint32_t dinRxFull = 0;
+uint32_t outputWrites = 0;
+uint32_t outputSkips = 0;
+uint32_t lastMidiPoll = 0;
+volatile boolean displayRan = false;
+unsigned long profileRateTimer = 0;
+int statsPage = 0;
+
+void profileReset() {
+  for (int i = 0; i < PROF_STAGES; i++) {
+    profileStats[i] = { 0xFFFFFFFF, 0, 0, 0, {} };
+  }
+  for (int p = 0; p < PROFILE_PORTS; p++) {
+    portRate[p] = 0;
+  }
+  dinRxFull = 0;
+  outputWrites = 0;
+  outputSkips = 0;
+}
+
+void profileRecord(int stage, uint32_t ticks) {
+  ProfileStat &stat = profileStats[stage];
+  if (ticks < stat.min) stat.min = ticks;
+  if (ticks > stat.max) stat.max = ticks;
+  stat.count++;
+  stat.total += ticks;
+  uint32_t us = ticks / PROFILE_TICKS_PER_US;
+  int bucket = us ? 32 - __builtin_clz(us) : 0;
+  stat.hist[bucket < PROFILE_BUCKETS ? bucket : PROFILE_BUCKETS - 1]++;
+}
+
+// Records the time since start against stage and returns now, so stages can be chained
+uint32_t profileStage(int stage, uint32_t start) {
+  uint32_t now = PROFILE_NOW();
+  profileRecord(stage, now - start);
+  return now;
+}
+
+struct ProfileScope {
+  int stage;
+  uint32_t start;
+  ProfileScope(int s) {
+    stage = s;
+    start = PROFILE_NOW();
+  }
+  ~ProfileScope() {
+    profileRecord(stage, PROFILE_NOW() - start);
+  }
+};
+
+void profileMessage(int port) {
+  portMessages[port]++;
+}
+
+void profileCheckDin() {
+  if (Serial1.available() >= PROFILE_DIN_RX_FULL) dinRxFull++;
+}
+
+// The gap between two MIDI polls is the longest a message can wait before its
+// handler runs. Gaps that the display thread ran in are also kept separately.
+void profilePollGap() {
+  uint32_t now = PROFILE_NOW();
+  if (lastMidiPoll) {
+    profileRecord(displayRan ? PROF_MIDI_GAP_DISPLAY : PROF_MIDI_GAP, now - lastMidiPoll);
+  }
+  displayRan = false;
+  lastMidiPoll = now;
+}
+
+void profileUpdateRates() {
+  if (millis() - profileRateTimer < 1000) return;
+  profileRateTimer = millis();
+  for (int p = 0; p < PROFILE_PORTS; p++) {
+    uint32_t count = portMessages[p];
+    portRate[p] = count - portLast[p];
+    portLast[p] = count;
+  }
+}
+
+float profileAverageUs(int stage) {
+  ProfileStat &stat = profileStats[stage];
+  if (stat.count == 0) return 0;
+  return (float)stat.total / stat.count / PROFILE_TICKS_PER_US;
+}
+
+float profileMaxUs(int stage) {
+  return (float)profileStats[stage].max / PROFILE_TICKS_PER_US;
+}
+
+void profileDump(const char *args) {
+  char line[96];
+  Serial.println("stage        count     min us   avg us   max us");
+  for (int i = 0; i < PROF_STAGES; i++) {
+    ProfileStat &stat = profileStats[i];
+    if (stat.count == 0) continue;
+    snprintf(line, sizeof(line), "%-12s %8lu %8.2f %8.2f %8.2f", PROFILE_NAMES[i], (unsigned long)stat.count,
+             (float)stat.min / PROFILE_TICKS_PER_US, profileAverageUs(i), profileMaxUs(i));
+    Serial.println(line);
+    Serial.print("  hist");
+    for (int b = 0; b < PROFILE_BUCKETS; b++) {
+      Serial.print(' ');
+      Serial.print(stat.hist[b]);
+    }
+    Serial.println();
+  }
+  for (int p = 0; p < PROFILE_PORTS; p++) {
+    snprintf(line, sizeof(line), "%-5s %6lu msg/s %10lu total", PORT_NAMES[p], (unsigned long)portRate[p], (unsigned long)portMessages[p]);
+    Serial.println(line);
+  }
+  Serial.print("din rx buffer full ");
+  Serial.println(dinRxFull);
+  Serial.print("output writes ");
+  Serial.print(outputWrites);
+  Serial.print(" skipped ");
+  Serial.println(outputSkips);
+}
+
+void profileResetCommand(const char *args) {
+  profileReset();
+  Serial.println("Stats reset");
+}
+
+void setupProfiler() {
+  profileReset();
+  consoleAppend("stats", "dump loop and handler timing", profileDump);
+  consoleAppend("reset", "clear timing stats", profileResetCommand);
+}
@@ -0,0 +1,121 @@
+/*
+  Quantizer - channel output modes that turn a CC into a 1V/oct note
+
+  In the Quant CC and Quant CC14 modes a channel output maps its CC, or its
+  14 bit pair, over QUANT_RANGE semitones from 0V and snaps it to the
+  nearest note of the output's scale and root. Each output has a table with
+  the pitch code for every semitone step, built when its scale or root
+  changes, so a CC costs a multiply and a lookup. Quantized outputs step
+  straight to each note rather than ramping.
+
+  Scales and roots are stored in the patch as two hex digits per output,
+  outputs 1-8 in one field and 9-16 in the next.
+
+  Console: quant lists the outputs, quant <output 1-16> <scale> <root 0-11>
+  sets one.
+*/
+
+#define QUANT_CC_MODE 8
+#define QUANT_CC14_MODE 9
+#define QUANT_RANGE 61  // Five octaves
+#define QUANT_SCALES 10
+
+const char *QUANT_SCALE_NAMES[QUANT_SCALES] = { "chromatic", "major", "minor", "dorian", "mixolydian",
+                                               "pent major", "pent minor", "blues", "harm minor", "whole tone" };
+const uint16_t QUANT_SCALE_MASKS[QUANT_SCALES] = {  // Bit n set when n semitones above the root is in the scale
+  0xFFF, 0xAB5, 0x5AD, 0x6AD, 0x6B5, 0x295, 0x4A9, 0x4E9, 0x9AD, 0x555
+};
+const char *NOTE_NAMES[12] = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
+
+uint8_t quantScale[CC_OUTPUTS];
+uint8_t quantRoot[CC_OUTPUTS];
+uint16_t quantCodes[CC_OUTPUTS][QUANT_RANGE];
+char quantField[CC_OUTPUTS / 2 * 2 + 1];
+
+boolean quantInScale(int i, int semitone) {
+  return QUANT_SCALE_MASKS[quantScale[i]] & (1 << ((semitone - quantRoot[i] + 12) % 12));
+}
+
+void quantBuild(int i) {
+  for (int step = 0; step < QUANT_RANGE; step++) {
+    int note = step;
+    for (int offset = 0; offset < 12; offset++) {  // Nearest, the lower one on a tie
+      if (step - offset >= 0 && quantInScale(i, step - offset)) {
+        note = step - offset;
+        break;
+      }
+      if (quantInScale(i, step + offset)) {
+        note = step + offset;
+        break;
+      }
+    }
+    quantCodes[i][step] = min((int)(note * NOTE_SF + 0.5f), PWM_MAX);
+  }
+}
+
+// 14 bit value to the pitch code of its note
+inline uint16_t quantCode(int i, uint16_t value) {
+  return quantCodes[i][(uint32_t)value * QUANT_RANGE >> 14];
+}
+
+boolean quantMode(int i) {
+  return CC_MAP[i][4] == QUANT_CC_MODE || CC_MAP[i][4] == QUANT_CC14_MODE;
+}
+
+void setQuant(int i, int scale, int root) {
+  quantScale[i] = constrain(scale, 0, QUANT_SCALES - 1);
+  quantRoot[i] = constrain(root, 0, 11);
+  quantBuild(i);
+}
+
+// Outputs 1-8 for half 0, 9-16 for half 1, missing outputs are chromatic from C
+void quantParse(int half, const char *field) {
+  size_t length = strlen(field);
+  for (int k = 0; k < CC_OUTPUTS / 2; k++) {
+    int packed = 0;
+    if (length >= (size_t)(k + 1) * 2) {
+      char digits[3] = { field[k * 2], field[k * 2 + 1], 0 };
+      packed = strtol(digits, NULL, 16);
+    }
+    setQuant(half * CC_OUTPUTS / 2 + k, packed >> 4, packed & 0xF);
+  }
+}
+
+const char *quantFormat(int half) {
+  for (int k = 0; k < CC_OUTPUTS / 2; k++) {
+    int i = half * CC_OUTPUTS / 2 + k;
+    snprintf(quantField + k * 2, 3, "%X%X", quantScale[i], quantRoot[i]);
+  }
+  return quantField;
+}
+
+void quantCommand(const char *args) {
+  int output = 0, scale = 0, root = 0;
+  if (sscanf(args, "%d %d %d", &output, &scale, &root) == 3 && output >= 1 && output <= CC_OUTPUTS) {
+    setQuant(output - 1, scale, root);
+  } else if (args[0]) {
+    Serial.println("quant <output 1-16> <scale> <root 0-11>, scales:");
+    for (int s = 0; s < QUANT_SCALES; s++) {
+      Serial.print(s);
+      Serial.print(" ");
+      Serial.println(QUANT_SCALE_NAMES[s]);
+    }
+    return;
+  }
+  for (int i = 0; i < CC_OUTPUTS; i++) {
+    Serial.print("ch");
+    Serial.print(i + 1);
+    Serial.print(" ");
+    Serial.print(NOTE_NAMES[quantRoot[i]]);
+    Serial.print(" ");
+    Serial.print(QUANT_SCALE_NAMES[quantScale[i]]);
+    Serial.println(quantMode(i) ? " (quantizing)" : "");
+  }
+}
+
+void setupQuantizer() {
+  for (int i = 0; i < CC_OUTPUTS; i++) {
+    setQuant(i, 0, 0);
+  }
+  consoleAppend("quant", "quant <output> <scale> <root> - quantizer scale per output", quantCommand);
+}
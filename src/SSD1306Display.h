@@ -3,6 +3,8 @@
 #include <Adafruit_SSD1306.h>
 
 #define DISPLAYTIMEOUT 2000
+#define MAIN_SLICE_TICKS 100  // 10ms, the main loop gives up the CPU itself when idle
+#define SLICE_TICKS_PER_MS 10 // TeensyThreads ticks are 100us
 #define OLED_MOSI   26
 #define OLED_CLK   27
 #define OLED_CS     3
@@ -34,6 +36,11 @@ int currentSettingsPart = SETTINGS;
 int paramType = PARAMETER;
 
 unsigned long timer = 0;
+int displayThreadId = 0;
+
+float clockBpm();
+boolean clockIsLocked();
+extern volatile uint32_t controlOverruns;
 
 void startTimer()
 {
@@ -210,11 +217,68 @@ void renderRecallPage() {
   patches.size() > 1 ? display.println(patches[1].patchName) : display.println(patches.last().patchName);
 }
 
-void showRenamingPage(String newName)
+void showRenamingPage(const char *newName)
 {
   newPatchName = newName;
 }
 
+void showRenamingPage(const String &name, char nextCharacter)
+{
+  char newName[PATCH_NAME_SIZE + 1];
+  snprintf(newName, sizeof(newName), "%s%c", name.c_str(), nextCharacter);
+  showRenamingPage(newName);
+}
+
+void renderStatsPage() {
+  char line[24];
+  display.clearDisplay();
+  display.setFont();
+  display.setTextColor(WHITE);
+  display.setTextSize(1);
+  display.setCursor(0, 0);
+  if (statsPage == STATS_STAGE_PAGES + 1) {
+    snprintf(line, sizeof(line), "bpm %6.1f %s", clockBpm(), clockIsLocked() ? "locked" : "");
+    display.println(line);
+    snprintf(line, sizeof(line), "jitter avg %5.0f", profileAverageUs(PROF_CLOCK_JITTER));
+    display.println(line);
+    snprintf(line, sizeof(line), "jitter max %5.0f", profileMaxUs(PROF_CLOCK_JITTER));
+    display.println(line);
+    snprintf(line, sizeof(line), "lock ms %8.0f", profileMaxUs(PROF_CLOCK_LOCK) / 1000);
+    display.println(line);
+    snprintf(line, sizeof(line), "int jitter %5.1f", profileMaxUs(PROF_MASTER_JITTER));
+    display.println(line);
+    snprintf(line, sizeof(line), "ctl tick %7.1f", profileMaxUs(PROF_CONTROL_TICK));
+    display.println(line);
+    snprintf(line, sizeof(line), "ctl overrun %4lu", (unsigned long)controlOverruns);
+    display.println(line);
+    return;
+  }
+  if (statsPage == STATS_STAGE_PAGES) {
+    for (int p = 0; p < PROFILE_PORTS; p++) {
+      snprintf(line, sizeof(line), "%-5s %6lu msg/s", PORT_NAMES[p], (unsigned long)portRate[p]);
+      display.println(line);
+    }
+    snprintf(line, sizeof(line), "din full %lu", (unsigned long)dinRxFull);
+    display.println(line);
+    snprintf(line, sizeof(line), "heap ops %lu", (unsigned long)heapGuardCount);
+    display.println(line);
+    snprintf(line, sizeof(line), "gap max %8.0f", profileMaxUs(PROF_MIDI_GAP));
+    display.println(line);
+    snprintf(line, sizeof(line), "gap+disp %7.0f", profileMaxUs(PROF_MIDI_GAP_DISPLAY));
+    display.println(line);
+    snprintf(line, sizeof(line), "gate late %6.0f", profileMaxUs(PROF_GATE_LATE));
+    display.println(line);
+    return;
+  }
+  //The first pages are the loop stages, the loop total and the MIDI handlers, avg and max in us
+  int first = statsPage * STATS_LINES;
+  int last = min(first + STATS_LINES, PROF_MIDI_GAP);
+  for (int i = first; i < last; i++) {
+    snprintf(line, sizeof(line), "%-9.9s%6.1f%6.0f", PROFILE_NAMES[i], profileAverageUs(i), profileMaxUs(i));
+    display.println(line);
+  }
+}
+
 void renderUpDown(uint16_t x, uint16_t y, uint16_t colour) {
   //Produces up/down indicator glyph at x,y
   display.setCursor(x, y);
@@ -262,12 +326,37 @@ void showCurrentParameterPage(const char *param, String val)
   showCurrentParameterPage(param, val, PARAMETER);
 }
 
+void showCurrentParameterPage(const char *param, const char *val)
+{
+  if (state == SETTINGS || state == SETTINGSVALUE)state = PARAMETER;//Exit settings page if showing
+  currentParameter = param;
+  currentValue = val;
+  paramType = PARAMETER;
+  startTimer();
+}
+
+//Shows prefix, number and suffix without building Strings on the heap
+void showCurrentParameterNumber(const char *param, const char *prefix, int number, const char *suffix = "")
+{
+  char val[24];
+  snprintf(val, sizeof(val), "%s%d%s", prefix, number, suffix);
+  showCurrentParameterPage(param, val);
+}
+
 void showPatchPage(String number, String patchName)
 {
   currentPgmNum = number;
   currentPatchName = patchName;
 }
 
+void showPatchPage(int number, const char *patchName)
+{
+  char num[8];
+  snprintf(num, sizeof(num), "%d", number);
+  currentPgmNum = num;
+  currentPatchName = patchName;
+}
+
 void showSettingsPage(const char *  option, const char * value, int settingsPart) {
   currentSettingsOption = option;
   currentSettingsValue = value;
@@ -279,6 +368,7 @@ void displayThread()
   threads.delay(2000); //Give bootup page chance to display
   while (1)
   {
+    displayRan = true;
     switch (state)
     {
       case PARAMETER:
@@ -316,12 +406,31 @@ void displayThread()
       case CCPARAMS:
         renderCurrentParamPage();
         break;
+      case STATS:
+        renderStatsPage();
+        break;
     }
     display.display();
+    displayRan = true;
+    threads.yield();
   }
 }
 
+//The display thread only runs when the main loop yields or its own slice is
+//due, so the slice sets how long MIDI can be held off while a frame is sent
+void setDisplaySlice(int ms) {
+  threads.setTimeSlice(displayThreadId, ms * SLICE_TICKS_PER_MS);
+}
+
 void setupDisplay() {
+  //Reserve once so later assignments copy into place instead of reallocating
+  currentParameter.reserve(24);
+  currentValue.reserve(24);
+  currentPgmNum.reserve(8);
+  currentPatchName.reserve(PATCH_NAME_SIZE);
+  newPatchName.reserve(PATCH_NAME_SIZE + 1);
   renderBootUpPage();
-  threads.addThread(displayThread);
+  displayThreadId = threads.addThread(displayThread);
+  threads.setTimeSlice(0, MAIN_SLICE_TICKS);
+  setDisplaySlice(displaySlice);
 }
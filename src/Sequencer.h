@@ -0,0 +1,285 @@
+/*
+  Arpeggiator and step sequencer - clocked notes on the poly group's voices
+
+  With a mode set, notes on the MIDI channel are held here instead of
+  playing the voices. The held notes, or the patch's steps, are expanded
+  into a pattern whenever they change, and the clock engine steps through
+  it from clockOutputs() along with the clock outputs: on the MIDI clock
+  tick, or from the internal clock's timer interrupt whatever loop() is
+  doing. Each step writes its pitch and velocity on the next voice of the
+  poly group and schedules the gate on the gate timer after the voice's gate
+  delay, for the gate length, so gate timing never waits on loop(). The gate
+  is always down for SEQ_GAP_US before the next step, so a full length gate
+  still retriggers.
+
+  Arpeggiator modes play the held notes up, down, up and down, at random or
+  in the order they were played, over 1 to 4 octaves, and stop when no notes
+  are held. The sequencer plays its steps whenever the clock runs,
+  transposed by the last held note from middle C. A step of 0 is a rest.
+
+  The time between steps is checked against the clock period and the
+  difference recorded as step jitter.
+
+  The patch stores mode:rate:gate %:octaves:length, then the 16 steps as
+  two hex digits each, 8 steps to a field.
+
+  Console: seq shows the settings and step jitter,
+  seq <mode> <rate> <gate %> <octaves> <length> sets them,
+  seq step <1-16> <note> sets a step.
+*/
+
+#define SEQ_OFF 0
+#define ARP_UP 1
+#define ARP_DOWN 2
+#define ARP_UP_DOWN 3
+#define ARP_RANDOM 4
+#define ARP_PLAYED 5
+#define SEQ_STEPS 6
+#define SEQ_MODES 7
+
+#define SEQ_SETTINGS 5
+#define SEQ_STEP_MAX 16
+#define SEQ_HELD_MAX 16
+#define SEQ_OCTAVES_MAX 4
+#define SEQ_PATTERN_MAX (SEQ_HELD_MAX * SEQ_OCTAVES_MAX * 2)
+#define SEQ_REST 0
+#define SEQ_GAP_US 1000
+#define SEQ_VELOCITY 100
+
+const char *SEQ_MODE_NAMES[SEQ_MODES] = { "off", "up", "down", "up/down", "random", "as played", "sequencer" };
+
+int seqMode = SEQ_OFF;  // Patch
+int seqRate = 2;        // Patch
+int seqGate = 50;       // % of the step, patch
+int seqOctaves = 1;     // Patch
+int seqLength = 16;     // Steps, patch
+uint8_t seqSteps[SEQ_STEP_MAX];  // Patch
+
+uint8_t seqHeld[SEQ_HELD_MAX];  // In the order played
+int seqHeldCount = 0;
+byte seqVelocity = SEQ_VELOCITY;
+
+volatile uint8_t seqPattern[SEQ_PATTERN_MAX];
+volatile int seqPatternLength = 0;
+volatile uint32_t seqIndex = 0;
+volatile uint32_t seqLastStep = 0;
+uint8_t seqVoice = 0;
+uint32_t seqRandom = 1;
+char seqField[PATCH_FIELD_SIZE];
+
+boolean seqActive() {
+  return seqMode != SEQ_OFF && polycount > 0 && chainMode == CHAIN_OFF;
+}
+
+// Expands the held notes or the steps into the pattern
+void seqBuild() {
+  uint8_t pattern[SEQ_PATTERN_MAX];
+  int length = 0;
+  if (seqMode == SEQ_STEPS) {
+    int shift = seqHeldCount ? seqHeld[seqHeldCount - 1] - 60 : 0;
+    for (int k = 0; k < seqLength; k++) {
+      pattern[length++] = seqSteps[k] == SEQ_REST ? SEQ_REST : constrain(seqSteps[k] + shift, 1, 127);
+    }
+  } else if (seqMode != SEQ_OFF) {
+    uint8_t notes[SEQ_HELD_MAX];
+    memcpy(notes, seqHeld, seqHeldCount);
+    if (seqMode != ARP_PLAYED) {
+      for (int i = 1; i < seqHeldCount; i++) {  // Insertion sort, a few notes at most
+        uint8_t note = notes[i];
+        int j = i;
+        for (; j > 0 && notes[j - 1] > note; j--) notes[j] = notes[j - 1];
+        notes[j] = note;
+      }
+    }
+    for (int octave = 0; octave < seqOctaves; octave++) {
+      for (int i = 0; i < seqHeldCount; i++) {
+        if (notes[i] + octave * 12 <= 127) pattern[length++] = notes[i] + octave * 12;
+      }
+    }
+    if (seqMode == ARP_DOWN) {
+      for (int i = 0; i < length / 2; i++) {
+        uint8_t note = pattern[i];
+        pattern[i] = pattern[length - 1 - i];
+        pattern[length - 1 - i] = note;
+      }
+    } else if (seqMode == ARP_UP_DOWN) {
+      for (int i = length - 2; i > 0; i--) pattern[length + (length - 2 - i)] = pattern[i];
+      if (length > 2) length = length * 2 - 2;
+    }
+  }
+  noInterrupts();
+  memcpy((uint8_t *)seqPattern, pattern, length);
+  seqPatternLength = length;
+  if (length == 0) {
+    seqIndex = 0;
+    seqLastStep = 0;
+  }
+  interrupts();
+}
+
+// From clockOutputs(), in the clock interrupts
+void seqClock(uint32_t position) {
+  if (!seqActive()) return;
+  uint16_t subticks = STEP_RATE_SUBTICKS[seqRate];
+  if (position % subticks) return;
+  int length = seqPatternLength;
+  if (length == 0) return;
+  uint32_t now = micros();
+  uint32_t stepUs = subticks * clockPeriod / CLOCK_SUBTICKS;
+  if (seqLastStep && now - seqLastStep < stepUs * 2) {
+    profileRecord(PROF_SEQ_JITTER, abs((int32_t)(now - seqLastStep - stepUs)) * PROFILE_TICKS_PER_US);
+  }
+  seqLastStep = now;
+  int index;
+  if (seqMode == ARP_RANDOM) {
+    seqRandom = seqRandom * 1664525 + 1013904223;
+    index = (seqRandom >> 16) % length;
+  } else {
+    index = seqIndex++ % length;
+  }
+  uint8_t note = seqPattern[index];
+  if (note == SEQ_REST) return;
+  if (seqVoice >= polycount) seqVoice = 0;
+  int voice = seqVoice++;
+  uint32_t width = max(stepUs * seqGate / 100, (uint32_t)SEQ_GAP_US);
+  if (stepUs > SEQ_GAP_US * 2) width = min(width, stepUs - SEQ_GAP_US);
+  glideTo(voice, noteCodeFor(voice, note));
+  pwmWrite(VELOCITY_PINS[voice], curveCode(CURVE_VELOCITY, seqVelocity, 8191));
+  gateSchedule(GATE_PINS[voice], HIGH, gateDelay[voice], width);
+  gateSchedule(NOTE_LEDS[voice], HIGH, gateDelay[voice], width);
+}
+
+// Each of these returns true when the note was taken by the arpeggiator or sequencer
+boolean seqNoteOff(byte channel, byte note) {
+  if (channel != midiChannel || !seqActive()) return false;
+  for (int i = 0; i < seqHeldCount; i++) {
+    if (seqHeld[i] != note) continue;
+    memmove(seqHeld + i, seqHeld + i + 1, seqHeldCount - i - 1);
+    seqHeldCount--;
+    if (seqMode != SEQ_STEPS || seqHeldCount) seqBuild();  // The sequence keeps its last transposition
+    break;
+  }
+  return true;
+}
+
+boolean seqNoteOn(byte channel, byte note, byte velocity) {
+  if (channel != midiChannel || !seqActive()) return false;
+  if (velocity == 0) return seqNoteOff(channel, note);
+  if (seqHeldCount == SEQ_HELD_MAX) return true;
+  for (int i = 0; i < seqHeldCount; i++) {
+    if (seqHeld[i] == note) return true;
+  }
+  if (seqHeldCount == 0 && seqMode != SEQ_STEPS) seqIndex = 0;  // A new chord starts from its first note
+  seqHeld[seqHeldCount++] = note;
+  seqVelocity = velocity;
+  seqBuild();
+  return true;
+}
+
+void seqReset() {
+  seqHeldCount = 0;
+  seqVoice = 0;
+  seqBuild();
+}
+
+void setSeq(const int *settings) {
+  seqMode = constrain(settings[0], SEQ_OFF, SEQ_MODES - 1);
+  seqRate = constrain(settings[1], 0, STEP_RATES - 1);
+  seqGate = constrain(settings[2], 1, 100);
+  seqOctaves = constrain(settings[3], 1, SEQ_OCTAVES_MAX);
+  seqLength = constrain(settings[4], 1, SEQ_STEP_MAX);
+  seqReset();
+}
+
+void seqParse(const char *field) {
+  int settings[SEQ_SETTINGS] = { SEQ_OFF, 2, 50, 1, SEQ_STEP_MAX };
+  sscanf(field, "%d:%d:%d:%d:%d", &settings[0], &settings[1], &settings[2], &settings[3], &settings[4]);
+  setSeq(settings);
+}
+
+const char *seqFormat() {
+  snprintf(seqField, sizeof(seqField), "%d:%d:%d:%d:%d", seqMode, seqRate, seqGate, seqOctaves, seqLength);
+  return seqField;
+}
+
+// Steps 1-8 for half 0, 9-16 for half 1, missing steps are rests
+void seqParseSteps(int half, const char *field) {
+  size_t length = strlen(field);
+  for (int k = 0; k < SEQ_STEP_MAX / 2; k++) {
+    int step = half * SEQ_STEP_MAX / 2 + k;
+    seqSteps[step] = SEQ_REST;
+    if (length >= (size_t)(k + 1) * 2) {
+      char digits[3] = { field[k * 2], field[k * 2 + 1], 0 };
+      seqSteps[step] = strtol(digits, NULL, 16) & 0x7F;
+    }
+  }
+  if (half == 1) seqBuild();
+}
+
+const char *seqFormatSteps(int half) {
+  for (int k = 0; k < SEQ_STEP_MAX / 2; k++) {
+    snprintf(seqField + k * 2, 3, "%02X", seqSteps[half * SEQ_STEP_MAX / 2 + k]);
+  }
+  return seqField;
+}
+
+void seqCommand(const char *args) {
+  int settings[SEQ_SETTINGS];
+  int step = 0, note = 0;
+  if (sscanf(args, "step %d %d", &step, &note) == 2 && step >= 1 && step <= SEQ_STEP_MAX) {
+    seqSteps[step - 1] = constrain(note, 0, 127);
+    seqBuild();
+  } else if (sscanf(args, "%d %d %d %d %d", &settings[0], &settings[1], &settings[2], &settings[3], &settings[4]) == 5) {
+    allNotesOff();
+    setSeq(settings);
+  } else if (args[0]) {
+    Serial.println("seq <mode> <rate> <gate %> <octaves> <length>, seq step <1-16> <note, 0 rest>");
+    Serial.print("modes");
+    for (int m = 0; m < SEQ_MODES; m++) {
+      Serial.print(m ? ", " : " ");
+      Serial.print(m);
+      Serial.print(" ");
+      Serial.print(SEQ_MODE_NAMES[m]);
+    }
+    Serial.println();
+    Serial.print("rates");
+    for (int r = 0; r < STEP_RATES; r++) {
+      Serial.print(r ? ", " : " ");
+      Serial.print(r);
+      Serial.print(" ");
+      Serial.print(STEP_RATE_NAMES[r]);
+    }
+    Serial.println();
+    return;
+  }
+  Serial.print("seq ");
+  Serial.print(SEQ_MODE_NAMES[seqMode]);
+  Serial.print(seqActive() || seqMode == SEQ_OFF ? "" : " (inactive)");
+  Serial.print(" rate ");
+  Serial.print(STEP_RATE_NAMES[seqRate]);
+  Serial.print(" gate ");
+  Serial.print(seqGate);
+  Serial.print("% octaves ");
+  Serial.print(seqOctaves);
+  Serial.print(" length ");
+  Serial.println(seqLength);
+  Serial.print("steps");
+  for (int k = 0; k < seqLength; k++) {
+    Serial.print(k ? "," : " ");
+    Serial.print(seqSteps[k]);
+  }
+  Serial.println();
+  Serial.print("pattern notes ");
+  Serial.print(seqPatternLength);
+  Serial.print(" step jitter max us ");
+  Serial.print(profileMaxUs(PROF_SEQ_JITTER), 1);
+  Serial.print(" avg us ");
+  Serial.println(profileAverageUs(PROF_SEQ_JITTER), 1);
+}
+
+void setupSequencer() {
+  seqParse("");
+  seqParseSteps(0, "");
+  seqParseSteps(1, "");
+  consoleAppend("seq", "arpeggiator and step sequencer settings and step jitter", seqCommand);
+}
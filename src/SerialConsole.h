@@ -0,0 +1,71 @@
+/*
+  USB serial console
+
+  Reads lines from the USB serial port and runs the command named by the first
+  word. Commands are appended from anywhere in the code, the same way settings
+  options are.
+*/
+
+#define CONSOLE_COMMANDS 32  // 22 registered, raise this when appending past it
+#define CONSOLE_LINE 96
+
+typedef void (*consoleHandler)(const char *args);
+
+struct ConsoleCommand {
+  const char *name;
+  const char *help;
+  consoleHandler handler;
+};
+
+ConsoleCommand consoleCommands[CONSOLE_COMMANDS];
+int consoleCommandCount = 0;
+char consoleLine[CONSOLE_LINE];
+int consoleLength = 0;
+
+void consoleAppend(const char *name, const char *help, consoleHandler handler) {
+  if (consoleCommandCount == CONSOLE_COMMANDS) {
+    Serial.print("console full, raise CONSOLE_COMMANDS for ");
+    Serial.println(name);
+    return;
+  }
+  consoleCommands[consoleCommandCount++] = { name, help, handler };
+}
+
+void consoleHelp(const char *args) {
+  for (int i = 0; i < consoleCommandCount; i++) {
+    Serial.print(consoleCommands[i].name);
+    Serial.print(" - ");
+    Serial.println(consoleCommands[i].help);
+  }
+}
+
+void consoleDispatch(char *line) {
+  char *args = line;
+  while (*args && *args != ' ') args++;
+  if (*args) *args++ = 0;
+  for (int i = 0; i < consoleCommandCount; i++) {
+    if (strcmp(line, consoleCommands[i].name) == 0) {
+      consoleCommands[i].handler(args);
+      return;
+    }
+  }
+  if (line[0]) consoleHelp(args);
+}
+
+void consoleRead() {
+  while (Serial.available()) {
+    char ch = Serial.read();
+    if (ch == '\r') continue;
+    if (ch == '\n') {
+      consoleLine[consoleLength] = 0;
+      consoleDispatch(consoleLine);
+      consoleLength = 0;
+    } else if (consoleLength < CONSOLE_LINE - 1) {
+      consoleLine[consoleLength++] = ch;
+    }
+  }
+}
+
+void setupConsole() {
+  consoleAppend("help", "list commands", consoleHelp);
+}
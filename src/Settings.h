@@ -6,14 +6,37 @@ void settingsKeyMode(int index, const char *value);
 void settingsTranspose(int index, const char *value);
 void settingsModWheelDepth(int index, const char *value);
 void settingsEncoderDir(char *value);
-void settingsSFAdj1(char *value);
-void settingsSFAdj2(char *value);
-void settingsSFAdj3(char *value);
-void settingsSFAdj4(char *value);
-void settingsSFAdj5(char *value);
-void settingsSFAdj6(char *value);
-void settingsSFAdj7(char *value);
-void settingsSFAdj8(char *value);
+void settingsSFAdj1(int index, const char *value);
+void settingsSFAdj2(int index, const char *value);
+void settingsSFAdj3(int index, const char *value);
+void settingsSFAdj4(int index, const char *value);
+void settingsSFAdj5(int index, const char *value);
+void settingsSFAdj6(int index, const char *value);
+void settingsSFAdj7(int index, const char *value);
+void settingsSFAdj8(int index, const char *value);
+void settingsChainMode(int index, const char *value);
+void settingsChainUnits(int index, const char *value);
+void settingsDisplaySlice(int index, const char *value);
+void setDisplaySlice(int ms);
+void settingsGateDelay(int index, const char *value);
+void settingsRetrigGap(int index, const char *value);
+void setAllGateDelays(uint32_t us);
+void setRetrigGap(uint32_t us);
+void settingsClockDiv(int index, const char *value);
+void settingsClockWidth(int index, const char *value);
+void settingsClockSwing(int index, const char *value);
+void settingsClockSource(int index, const char *value);
+void settingsTempo(int index, const char *value);
+void setClockSource(int source);
+void setMasterTempo(int bpm);
+void settingsMpeZone(int index, const char *value);
+void settingsMpeExpression(int index, const char *value);
+void settingsMpeMembers(int index, const char *value);
+void setMpeZone(int zone);
+void setMpeExpression(int expression);
+void setMpeMembers(int members);
+void setSFAdjust(int voice, int step);
+void allNotesOff();
 
 int currentIndexMIDICh();
 int currentIndexGATECh();
@@ -29,6 +52,23 @@ int currentIndexSFAdj5();
 int currentIndexSFAdj6();
 int currentIndexSFAdj7();
 int currentIndexSFAdj8();
+int currentIndexChainMode();
+int currentIndexChainUnits();
+int currentIndexDisplaySlice();
+int currentIndexGateDelay();
+int currentIndexRetrigGap();
+int currentIndexClockDiv();
+int currentIndexClockWidth();
+int currentIndexClockSwing();
+int currentIndexClockSource();
+int currentIndexTempo();
+int currentIndexMpeZone();
+int currentIndexMpeExpression();
+int currentIndexMpeMembers();
+
+extern int clockDiv;
+extern int clockWidth;
+extern int clockSwing;
 
 void settingsMIDICh(int index, const char *value) {
   if (strcmp(value, "ALL") == 0) {
@@ -181,75 +221,107 @@ void settingsEncoderDir(int index, const char *value) {
 }
 
 void settingsSFAdj1(int index, const char *value) {
-  if (strcmp(value, "Type 1") == 0) {
-    encCW = true;
-  } else {
-    encCW = false;
-  }
-  storeSFAdjust(0, 1);
+  setSFAdjust(0, index - 10);
 }
 
 void settingsSFAdj2(int index, const char *value) {
-  if (strcmp(value, "Type 1") == 0) {
-    encCW = true;
-  } else {
-    encCW = false;
-  }
-  storeSFAdjust(1, 1);
+  setSFAdjust(1, index - 10);
 }
 
 void settingsSFAdj3(int index, const char *value) {
-  if (strcmp(value, "Type 1") == 0) {
-    encCW = true;
-  } else {
-    encCW = false;
-  }
-  storeSFAdjust(2, 1);
+  setSFAdjust(2, index - 10);
 }
 
 void settingsSFAdj4(int index, const char *value) {
-  if (strcmp(value, "Type 1") == 0) {
-    encCW = true;
-  } else {
-    encCW = false;
-  }
-  storeSFAdjust(3, 1);
+  setSFAdjust(3, index - 10);
 }
 
 void settingsSFAdj5(int index, const char *value) {
-  if (strcmp(value, "Type 1") == 0) {
-    encCW = true;
-  } else {
-    encCW = false;
-  }
-  storeSFAdjust(4, 1);
+  setSFAdjust(4, index - 10);
 }
 
 void settingsSFAdj6(int index, const char *value) {
-  if (strcmp(value, "Type 1") == 0) {
-    encCW = true;
-  } else {
-    encCW = false;
-  }
-  storeSFAdjust(5, 1);
+  setSFAdjust(5, index - 10);
 }
 
 void settingsSFAdj7(int index, const char *value) {
-  if (strcmp(value, "Type 1") == 0) {
-    encCW = true;
-  } else {
-    encCW = false;
-  }
-  storeSFAdjust(6, 1);
+  setSFAdjust(6, index - 10);
 }
 
 void settingsSFAdj8(int index, const char *value) {
-  if (strcmp(value, "Type 1") == 0) {
-    encCW = true;
-  } else {
-    encCW = false;
+  setSFAdjust(7, index - 10);
+}
+
+void settingsChainMode(int index, const char *value) {
+  if (strcmp(value, "Off") == 0) {
+    chainMode = 0;
+  }
+  if (strcmp(value, "Leader") == 0) {
+    chainMode = 1;
+  }
+  if (strcmp(value, "Follower 1") == 0) {
+    chainMode = 2;
   }
-  storeSFAdjust(7, 1);
+  if (strcmp(value, "Follower 2") == 0) {
+    chainMode = 3;
+  }
+  allNotesOff();
+  storeChainMode(chainMode);
+}
+
+void settingsChainUnits(int index, const char *value) {
+  chainUnits = atoi(value);
+  allNotesOff();
+  storeChainUnits(chainUnits);
+}
+
+void settingsDisplaySlice(int index, const char *value) {
+  displaySlice = atoi(value);
+  setDisplaySlice(displaySlice);
+  storeDisplaySlice(displaySlice);
+}
+
+void settingsGateDelay(int index, const char *value) {
+  setAllGateDelays(atoi(value));
+}
+
+void settingsRetrigGap(int index, const char *value) {
+  setRetrigGap(atoi(value));
+}
+
+void settingsClockDiv(int index, const char *value) {
+  clockDiv = atoi(value);
+  storeClockDiv(clockDiv);
+}
+
+void settingsClockWidth(int index, const char *value) {
+  clockWidth = atoi(value);
+  storeClockWidth(clockWidth);
+}
+
+void settingsClockSwing(int index, const char *value) {
+  clockSwing = atoi(value);
+  storeClockSwing(clockSwing);
+}
+
+void settingsClockSource(int index, const char *value) {
+  setClockSource(index);
+}
+
+void settingsTempo(int index, const char *value) {
+  setMasterTempo(atoi(value));
+}
+
+void settingsMpeZone(int index, const char *value) {
+  setMpeZone(index);
+}
+
+void settingsMpeExpression(int index, const char *value) {
+  setMpeExpression(index);
+}
+
+void settingsMpeMembers(int index, const char *value) {
+  setMpeMembers(index);
 }
 
 int currentIndexMIDICh() {
@@ -276,36 +348,145 @@ int currentIndexEncoderDir() {
   return getEncoderDir() ? 0 : 1;
 }
 
+//Scales stored by older versions that aren't on the list show as the nearest
+int currentIndexSFAdj(int voice) {
+  return constrain((int)roundf((getSFAdjust(voice) - 1.0f) / SF_ADJ_STEP), -10, 10) + 10;
+}
+
 int currentIndexSFAdj1() {
-  return getSFAdjust(0);
+  return currentIndexSFAdj(0);
 }
 
 int currentIndexSFAdj2() {
-  return getSFAdjust(1);
+  return currentIndexSFAdj(1);
 }
 
 int currentIndexSFAdj3() {
-  return getSFAdjust(2);
+  return currentIndexSFAdj(2);
 }
 
 int currentIndexSFAdj4() {
-  return getSFAdjust(3);
+  return currentIndexSFAdj(3);
 }
 
 int currentIndexSFAdj5() {
-  return getSFAdjust(4);
+  return currentIndexSFAdj(4);
 }
 
 int currentIndexSFAdj6() {
-  return getSFAdjust(5);
+  return currentIndexSFAdj(5);
 }
 
 int currentIndexSFAdj7() {
-  return getSFAdjust(6);
+  return currentIndexSFAdj(6);
 }
 
 int currentIndexSFAdj8() {
-  return getSFAdjust(7);
+  return currentIndexSFAdj(7);
+}
+
+int currentIndexChainMode() {
+  return getChainMode();
+}
+
+int currentIndexChainUnits() {
+  return getChainUnits() - 1;
+}
+
+int currentIndexDisplaySlice() {
+  switch (getDisplaySlice()) {
+    case 1:
+      return 0;
+    case 5:
+      return 2;
+    case 10:
+      return 3;
+  }
+  return 1;
+}
+
+//The per voice delays can be set apart with the gatedelay command, voice 1 is shown
+int currentIndexGateDelay() {
+  switch (getGateDelay(0) * 10) {
+    case 100:
+      return 1;
+    case 250:
+      return 2;
+    case 500:
+      return 3;
+    case 1000:
+      return 4;
+    case 2000:
+      return 5;
+  }
+  return 0;
+}
+
+int currentIndexRetrigGap() {
+  switch (getRetrigGap() * 100) {
+    case 500:
+      return 1;
+    case 1000:
+      return 2;
+    case 2000:
+      return 3;
+    case 5000:
+      return 4;
+  }
+  return 0;
+}
+
+int currentIndexClockDiv() {
+  switch (getClockDiv()) {
+    case 2:
+      return 1;
+    case 4:
+      return 2;
+    case 8:
+      return 3;
+  }
+  return 0;
+}
+
+int currentIndexClockWidth() {
+  switch (getClockWidth()) {
+    case 1:
+      return 0;
+    case 2:
+      return 1;
+    case 5:
+      return 2;
+    case 20:
+      return 4;
+    case 60:
+      return 5;
+  }
+  return 3;
+}
+
+int currentIndexClockSwing() {
+  return (getClockSwing() - 50) / 4;
+}
+
+int currentIndexClockSource() {
+  return getClockSource();
+}
+
+//Tempos set from the console that aren't on the list show as the nearest
+int currentIndexTempo() {
+  return (constrain(getTempo(), 60, 180) - 60 + 2) / 5;
+}
+
+int currentIndexMpeZone() {
+  return getMpeZone();
+}
+
+int currentIndexMpeExpression() {
+  return getMpeExpression();
+}
+
+int currentIndexMpeMembers() {
+  return getMpeMembers();
 }
 
 // add settings to the circular buffer
@@ -313,6 +494,9 @@ void setUpSettings() {
   settings::append(settings::SettingsOption{ "MIDI Ch.", { "All", "1", "2", "3", "4", "5", "6", "7", "8", "9", "10", "11", "12", "13", "14", "15", "16", "\0" }, settingsMIDICh, currentIndexMIDICh });
   settings::append(settings::SettingsOption{ "Gate Ch.", { "All", "1", "2", "3", "4", "5", "6", "7", "8", "9", "10", "11", "12", "13", "14", "15", "16", "\0" }, settingsGATECh, currentIndexGATECh });
   settings::append(settings::SettingsOption{ "Key Mode", { "Poly", "Unison T", "Unison B", "Unison L", "Mono T", "Mono B", "Mono L", "\0" }, settingsKeyMode, currentIndexKeyMode });
+  settings::append(settings::SettingsOption{ "MPE Zone", { "Off", "Lower", "Upper", "\0" }, settingsMpeZone, currentIndexMpeZone });
+  settings::append(settings::SettingsOption{ "MPE Express", { "Pressure", "Timbre", "\0" }, settingsMpeExpression, currentIndexMpeExpression });
+  settings::append(settings::SettingsOption{ "MPE Members", { "0", "1", "2", "3", "4", "5", "6", "7", "8", "9", "10", "11", "12", "13", "14", "15", "\0" }, settingsMpeMembers, currentIndexMpeMembers });
   settings::append(settings::SettingsOption{ "Transpose", { "-12", "-11", "-10", "-9", "-8", "-7", "-6", "-5", "-4", "-3", "-2", "-1", "0", "+1", "+2", "+3", "+4", "+5", "+6", "+7", "+8", "+9", "+10", "+11", "+12", "\0" }, settingsTranspose, currentIndexTranspose });
   settings::append(settings::SettingsOption{ "Octave", { "-2", "-1", "0", "+1", "+2", "\0" }, settingsOctave, currentIndexOctave });
   settings::append(settings::SettingsOption{ "Encoder", { "Type 1", "Type 2", "\0" }, settingsEncoderDir, currentIndexEncoderDir });
@@ -324,5 +508,15 @@ void setUpSettings() {
   settings::append(settings::SettingsOption{ "SF Adjust 6", { "-10", "-9", "-8", "-7", "-6", "-5", "-4", "-3", "-2", "-1", "0", "+1", "+2", "+3", "+4", "+5", "+6", "+7", "+8", "+9", "+10", "\0" }, settingsSFAdj6, currentIndexSFAdj6 });
   settings::append(settings::SettingsOption{ "SF Adjust 7", { "-10", "-9", "-8", "-7", "-6", "-5", "-4", "-3", "-2", "-1", "0", "+1", "+2", "+3", "+4", "+5", "+6", "+7", "+8", "+9", "+10", "\0" }, settingsSFAdj7, currentIndexSFAdj7 });
   settings::append(settings::SettingsOption{ "SF Adjust 8", { "-10", "-9", "-8", "-7", "-6", "-5", "-4", "-3", "-2", "-1", "0", "+1", "+2", "+3", "+4", "+5", "+6", "+7", "+8", "+9", "+10", "\0" }, settingsSFAdj8, currentIndexSFAdj8 });
+  settings::append(settings::SettingsOption{ "Chain Mode", { "Off", "Leader", "Follower 1", "Follower 2", "\0" }, settingsChainMode, currentIndexChainMode });
+  settings::append(settings::SettingsOption{ "Chain Units", { "1", "2", "3", "\0" }, settingsChainUnits, currentIndexChainUnits });
+  settings::append(settings::SettingsOption{ "Gate Delay us", { "0", "100", "250", "500", "1000", "2000", "\0" }, settingsGateDelay, currentIndexGateDelay });
+  settings::append(settings::SettingsOption{ "Retrig Gap us", { "0", "500", "1000", "2000", "5000", "\0" }, settingsRetrigGap, currentIndexRetrigGap });
+  settings::append(settings::SettingsOption{ "Clock Source", { "External", "Internal", "\0" }, settingsClockSource, currentIndexClockSource });
+  settings::append(settings::SettingsOption{ "Tempo", { "60", "65", "70", "75", "80", "85", "90", "95", "100", "105", "110", "115", "120", "125", "130", "135", "140", "145", "150", "155", "160", "165", "170", "175", "180", "\0" }, settingsTempo, currentIndexTempo });
+  settings::append(settings::SettingsOption{ "Clock Div", { "1", "2", "4", "8", "\0" }, settingsClockDiv, currentIndexClockDiv });
+  settings::append(settings::SettingsOption{ "Clock Width ms", { "1", "2", "5", "10", "20", "60", "\0" }, settingsClockWidth, currentIndexClockWidth });
+  settings::append(settings::SettingsOption{ "Swing %", { "50", "54", "58", "62", "66", "70", "74", "\0" }, settingsClockSwing, currentIndexClockSwing });
+  settings::append(settings::SettingsOption{ "Display ms", { "1", "2", "5", "10", "\0" }, settingsDisplaySlice, currentIndexDisplaySlice });
 
 }
@@ -0,0 +1,127 @@
+/*
+  Drum triggers - gate channel notes to the free gates
+
+  Each note on the gate channel looks up a bitmask of the free gates set to
+  it, built whenever the poly count or a gate's note changes, so a note
+  costs the same whatever the gates are set to. A gate with a pulse width
+  fires a pulse of exactly that width from the gate timer on note on and
+  ignores the note off, so drum machines' short or zero length notes still
+  trigger. A gate with no width follows the note as before.
+
+  A channel output in Accent mode follows the velocity of its gate's notes,
+  outputs 1 and 9 for gate 1 and so on, through the output's response curve.
+
+  Widths are stored in the patch in ms, 0 for a held gate.
+
+  Console: trig lists the gates, trig <gate 1-8> <ms> sets a width.
+*/
+
+#define TRIG_ACCENT_MODE 12
+#define TRIG_WIDTH_MAX 99   // ms
+#define TRIG_LED_MIN_US 20000
+
+uint8_t trigGates[128];           // Gates set to each note
+uint8_t trigPulse = 0;            // Gates with a pulse width
+uint8_t trigWidth[NO_OF_VOICES];  // ms, patch
+char trigField[PATCH_FIELD_SIZE];
+
+void trigBuild() {
+  memset(trigGates, 0, sizeof(trigGates));
+  trigPulse = 0;
+  for (int g = polycount; g < NO_OF_VOICES; g++) {
+    if (GATE_NOTES[g] > GATE_NOTE_MAX || (euclidGates & (1 << g))) continue;  // Clock output or pattern
+    trigGates[GATE_NOTES[g]] |= 1 << g;
+    if (trigWidth[g]) trigPulse |= 1 << g;
+  }
+}
+
+void trigAccent(int g, byte velocity) {
+  for (int i = g; i < CC_OUTPUTS; i += NO_OF_VOICES) {
+    if (CC_MAP[i][2] != 0 || CC_MAP[i][4] != TRIG_ACCENT_MODE) continue;
+    outputSet(i, curveCode(i, velocity, 7720));
+    ledSet(CC_MAP[i][5]);
+    outputLEDS[i] = millis();
+  }
+}
+
+void trigNoteOn(byte note, byte velocity) {
+  uint8_t gates = trigGates[note & 0x7F];
+  while (gates) {
+    int g = __builtin_ctz(gates);
+    gates &= gates - 1;
+    if (trigPulse & (1 << g)) {
+      uint32_t width = trigWidth[g] * 1000;
+      gateSchedule(g, HIGH, 0, width);
+      gateSchedule(g + 16, HIGH, 0, max(width, (uint32_t)TRIG_LED_MIN_US));
+    } else {
+      srSet(g, HIGH);
+      srSet(g + 16, HIGH);
+    }
+    trigAccent(g, velocity);
+  }
+}
+
+void trigNoteOff(byte note) {
+  uint8_t gates = trigGates[note & 0x7F] & ~trigPulse;
+  while (gates) {
+    int g = __builtin_ctz(gates);
+    gates &= gates - 1;
+    srSet(g, LOW);
+    srSet(g + 16, LOW);
+  }
+}
+
+void setTrigWidth(int g, int ms) {
+  trigWidth[g] = constrain(ms, 0, TRIG_WIDTH_MAX);
+  trigBuild();
+}
+
+void trigParse(const char *field) {
+  int ms[NO_OF_VOICES] = {};
+  sscanf(field, "%d:%d:%d:%d:%d:%d:%d:%d", &ms[0], &ms[1], &ms[2], &ms[3], &ms[4], &ms[5], &ms[6], &ms[7]);
+  for (int g = 0; g < NO_OF_VOICES; g++) {
+    trigWidth[g] = constrain(ms[g], 0, TRIG_WIDTH_MAX);
+  }
+  trigBuild();
+}
+
+const char *trigFormat() {
+  snprintf(trigField, sizeof(trigField), "%d:%d:%d:%d:%d:%d:%d:%d", trigWidth[0], trigWidth[1], trigWidth[2], trigWidth[3],
+           trigWidth[4], trigWidth[5], trigWidth[6], trigWidth[7]);
+  return trigField;
+}
+
+void trigCommand(const char *args) {
+  int gate = 0, ms = 0;
+  if (sscanf(args, "%d %d", &gate, &ms) == 2 && gate >= 1 && gate <= NO_OF_VOICES) {
+    setTrigWidth(gate - 1, ms);
+  } else if (args[0]) {
+    Serial.println("trig <gate 1-8> <ms, 0 to follow the note>");
+    return;
+  }
+  for (int g = 0; g < NO_OF_VOICES; g++) {
+    Serial.print("gate ");
+    Serial.print(g + 1);
+    if (g < polycount) {
+      Serial.println(" voice");
+    } else if (euclidGates & (1 << g)) {
+      Serial.println(" pattern");
+    } else if (GATE_NOTES[g] > GATE_NOTE_MAX) {
+      Serial.println(" clock");
+    } else {
+      Serial.print(" note ");
+      Serial.print(GATE_NOTES[g]);
+      if (trigWidth[g]) {
+        Serial.print(" trigger ms ");
+        Serial.println(trigWidth[g]);
+      } else {
+        Serial.println(" held");
+      }
+    }
+  }
+}
+
+void setupTriggers() {
+  trigParse("");
+  consoleAppend("trig", "trig <gate> <ms> - drum trigger pulse widths", trigCommand);
+}
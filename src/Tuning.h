@@ -0,0 +1,219 @@
+/*
+  Tunings - Scala scales and keyboard mappings from the SD card
+
+  Put name.scl, and optionally name.kbm, in /tunings on the SD card. The
+  Tuning parameter page steps through the scales found at startup and the
+  patch stores the name, empty for equal temperament. Recalling a patch with
+  a different tuning reads and compiles it into the per voice note tables,
+  so a microtuned note costs the same as any other.
+
+  There's no absolute pitch on a 1V/oct output, so the mapping's reference
+  frequency is ignored and its reference note is kept at its equal tempered
+  voltage. Without a .kbm the scale starts on middle C, one scale degree per
+  key. Unmapped keys play the equal tempered pitch.
+
+  Console: tuning shows the tuning and how long it took to compile,
+  tuning <name> loads one into the patch, tuning off goes back to 12-TET.
+*/
+
+#define TUNING_DIR "/tunings/"
+#define TUNING_NAME_SIZE 14  // 13 characters and zero byte
+#define TUNING_LIST_MAX 32
+#define TUNING_DEGREES_MAX 128
+#define TUNING_LINE_SIZE 64
+
+char tuningName[TUNING_NAME_SIZE] = "";  // Patch, empty for 12-TET
+char tuningLoaded[TUNING_NAME_SIZE] = "";
+char tuningList[TUNING_LIST_MAX][TUNING_NAME_SIZE];
+int tuningCount = 0;
+uint32_t tuningCompileUs = 0;
+
+float scaleCents[TUNING_DEGREES_MAX + 1];  // Degree 0 is 0 cents, the last is the period
+int scaleDegrees = 0;
+
+struct KeyMap {
+  int size;  // 0 for one degree per key
+  int middle;
+  int reference;
+  int octaveDegree;
+  int16_t degree[TUNING_DEGREES_MAX];  // -1 for unmapped
+};
+
+KeyMap keyMap;
+
+// Next line that isn't a comment, false at the end of the file
+boolean tuningReadLine(File &file, char *line) {
+  size_t n;
+  while ((n = readField(&file, line, TUNING_LINE_SIZE, "\n"))) {
+    char ch;
+    if (line[n - 1] != '\n') {
+      while (file.read(&ch, 1) == 1 && ch != '\n');  // Rest of a long description
+    }
+    char *end = line + strlen(line);
+    while (end > line && (end[-1] == '\n' || end[-1] == ' ' || end[-1] == '\t')) *--end = 0;
+    char *start = line;
+    while (*start == ' ' || *start == '\t') start++;
+    if (*start == '!') continue;
+    memmove(line, start, strlen(start) + 1);
+    return true;
+  }
+  return false;
+}
+
+// Scala pitch: cents if it has a point, otherwise a ratio or a whole number
+float tuningParsePitch(const char *text) {
+  if (strchr(text, '.')) return strtof(text, NULL);
+  char *end;
+  float numerator = strtol(text, &end, 10);
+  float denominator = *end == '/' ? strtol(end + 1, NULL, 10) : 1;
+  if (numerator <= 0 || denominator <= 0) return 0;
+  return 1200.0f * log2f(numerator / denominator);
+}
+
+boolean tuningReadScale(const char *name) {
+  char path[32];
+  char line[TUNING_LINE_SIZE];
+  snprintf(path, sizeof(path), TUNING_DIR "%s.scl", name);
+  File file = patchOpen(path);
+  if (!file) return false;
+  int count = 0;
+  boolean ok = tuningReadLine(file, line) && tuningReadLine(file, line);  // Description then count
+  if (ok) count = atoi(line);
+  ok = ok && count > 0 && count <= TUNING_DEGREES_MAX;
+  scaleCents[0] = 0;
+  for (int i = 1; ok && i <= count; i++) {
+    ok = tuningReadLine(file, line);
+    scaleCents[i] = tuningParsePitch(line);
+  }
+  patchClose(file);
+  if (ok) scaleDegrees = count;
+  return ok;
+}
+
+void tuningReadKeyMap(const char *name) {
+  char path[32];
+  char line[TUNING_LINE_SIZE];
+  keyMap = { 0, 60, 60, scaleDegrees, {} };
+  snprintf(path, sizeof(path), TUNING_DIR "%s.kbm", name);
+  File file = patchOpen(path);
+  if (!file) return;
+  int header[7];  // Size, first, last, middle, reference note, reference frequency, octave degree
+  boolean ok = true;
+  for (int i = 0; ok && i < 7; i++) {
+    ok = tuningReadLine(file, line);
+    header[i] = atoi(line);
+  }
+  if (ok && header[0] >= 0 && header[0] <= TUNING_DEGREES_MAX) {
+    keyMap.size = header[0];
+    keyMap.middle = constrain(header[3], 0, 127);
+    keyMap.reference = constrain(header[4], 0, 127);
+    keyMap.octaveDegree = header[6] > 0 ? header[6] : scaleDegrees;
+    for (int i = 0; i < keyMap.size; i++) {
+      keyMap.degree[i] = tuningReadLine(file, line) && line[0] != 'x' ? atoi(line) : -1;
+    }
+  }
+  patchClose(file);
+}
+
+// Cents of a key from the middle key, false when it's unmapped
+boolean tuningKeyCents(int note, float &cents) {
+  int steps = note - keyMap.middle;
+  int degree = steps;
+  if (keyMap.size > 0) {
+    int octave = steps >= 0 ? steps / keyMap.size : -((keyMap.size - 1 - steps) / keyMap.size);
+    int mapped = keyMap.degree[steps - octave * keyMap.size];
+    if (mapped < 0) return false;
+    degree = octave * keyMap.octaveDegree + mapped;
+  }
+  int period = degree >= 0 ? degree / scaleDegrees : -((scaleDegrees - 1 - degree) / scaleDegrees);
+  cents = period * scaleCents[scaleDegrees] + scaleCents[degree - period * scaleDegrees];
+  return true;
+}
+
+void tuningCompile() {
+  float reference = 0;
+  if (!tuningKeyCents(keyMap.reference, reference)) reference = (keyMap.reference - keyMap.middle) * 100.0f;
+  for (int note = 0; note < 128; note++) {
+    float cents;
+    tuningSemis[note] = tuningKeyCents(note, cents) ? keyMap.reference + (cents - reference) / 100.0f : note;
+  }
+}
+
+void tuningEqual() {
+  for (int note = 0; note < 128; note++) {
+    tuningSemis[note] = note;
+  }
+}
+
+// Sets the patch tuning, reading it from the card only if it isn't loaded already
+void setTuning(const char *name) {
+  uint32_t start = micros();
+  strlcpy(tuningName, name, TUNING_NAME_SIZE);
+  if (strcmp(tuningName, tuningLoaded) != 0) {
+    if (tuningName[0] && cardStatus && tuningReadScale(tuningName)) {
+      tuningReadKeyMap(tuningName);
+      tuningCompile();
+    } else {
+      tuningName[0] = 0;
+      tuningEqual();
+    }
+    strlcpy(tuningLoaded, tuningName, TUNING_NAME_SIZE);
+  }
+  calBuildNotes();
+  tuningCompileUs = micros() - start;
+}
+
+// Scales on the card, for the parameter page
+void tuningScan() {
+  tuningCount = 0;
+  if (!cardStatus) return;
+  File dir = patchOpen(TUNING_DIR);
+  if (!dir) return;
+  while (tuningCount < TUNING_LIST_MAX) {
+    File file = patchOpenNext(dir);
+    if (!file) break;
+    const char *name = file.name();
+    const char *dot = strrchr(name, '.');
+    if (!file.isDirectory() && dot && strcasecmp(dot, ".scl") == 0 && dot - name < TUNING_NAME_SIZE) {
+      strlcpy(tuningList[tuningCount++], name, dot - name + 1);
+    }
+    patchClose(file);
+  }
+  patchClose(dir);
+}
+
+// Steps through 12-TET and the scales on the card
+void tuningStep(int direction) {
+  int index = -1;
+  for (int i = 0; i < tuningCount; i++) {
+    if (strcmp(tuningList[i], tuningName) == 0) index = i;
+  }
+  index += direction;
+  if (index >= tuningCount) index = -1;
+  if (index < -1) index = tuningCount - 1;
+  setTuning(index < 0 ? "" : tuningList[index]);
+}
+
+void updateTuning() {
+  showCurrentParameterPage("Tuning", tuningName[0] ? tuningName : "12-TET");
+}
+
+void tuningCommand(const char *args) {
+  if (strcmp(args, "off") == 0) {
+    setTuning("");
+  } else if (args[0]) {
+    setTuning(args);
+    if (!tuningName[0]) Serial.println("tuning not found in " TUNING_DIR);
+  }
+  Serial.print("tuning ");
+  Serial.print(tuningName[0] ? tuningName : "12-TET");
+  Serial.print(" degrees ");
+  Serial.print(tuningName[0] ? scaleDegrees : 12);
+  Serial.print(" compile us ");
+  Serial.println(tuningCompileUs);
+}
+
+void setupTuning() {
+  tuningScan();
+  consoleAppend("tuning", "tuning [name|off] - Scala tuning for the patch", tuningCommand);
+}
@@ -0,0 +1,269 @@
+/*
+  Voice chain - several units acting as one 16 or 24 voice converter
+
+  The leader allocates voices across every unit in the chain and sends each
+  assignment out of CHAIN_SERIAL as a 3 byte message. Every follower echoes each
+  byte to the next unit as soon as it arrives, before decoding it, so a hop
+  only adds one byte time. The follower then applies the messages that fall
+  inside its own block of voices.
+
+  Wiring: leader TX -> follower 1 RX, follower 1 TX -> follower 2 RX.
+  All units should use the same Poly Count, each unit owns polycount voices.
+
+  Message: 1tt vvvvv, note, velocity
+  tt = CHAIN_MSG_OFF / CHAIN_MSG_ON / CHAIN_MSG_ALLOFF, vvvvv = chain voice
+
+  Console: chain shows the mode and units, chain test [events] runs a random
+  note stream through the leader's allocation and encoder and pipes the bytes
+  through a decoder for each follower in memory, with a truncated message
+  now and then to check they resync. Each follower's voices are checked
+  against the leader's after every message. Nothing is sent and the outputs
+  aren't touched.
+*/
+
+#define CHAIN_SERIAL Serial4  // RX 16, TX 17
+#define CHAIN_BAUD 1000000
+#define CHAIN_MAX_UNITS 3
+
+#define CHAIN_OFF 0
+#define CHAIN_LEADER 1
+#define CHAIN_FOLLOWER1 2
+#define CHAIN_FOLLOWER2 3
+
+#define CHAIN_MSG_OFF 0
+#define CHAIN_MSG_ON 1
+#define CHAIN_MSG_ALLOFF 2
+#define CHAIN_TEST_EVENTS 2000
+#define CHAIN_TEST_EVENTS_MAX 100000
+
+void voiceNoteOn(int voice, byte note, byte velocity);
+void voiceNoteOff(int voice);
+void allNotesOff();
+int allocFrom(const VoiceAndNote *set, int count, int note);
+
+struct VoiceAndNote chainVoices[CHAIN_MAX_UNITS * NO_OF_VOICES];
+
+struct ChainParser {
+  byte status;
+  byte data[2];
+  byte count;
+};
+
+ChainParser chainIn;
+
+void chainEncode(byte *message, byte type, int voice, byte note, byte velocity) {
+  message[0] = 0x80 | (type << 5) | (voice & 0x1F);
+  message[1] = note & 0x7F;
+  message[2] = velocity & 0x7F;
+}
+
+void chainSend(byte type, int voice, byte note, byte velocity) {
+  byte message[3];
+  chainEncode(message, type, voice, note, velocity);
+  CHAIN_SERIAL.write(message, 3);
+}
+
+// Takes one byte, true when it completes a message in the parser
+boolean chainDecode(ChainParser &p, byte b) {
+  if (b & 0x80) {
+    p.status = b;
+    p.count = 0;
+  } else if (p.status) {
+    p.data[p.count++] = b;
+    if (p.count == 2) {
+      p.count = 0;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Voice in the unit's own block, -1 when the message is for another unit
+int chainUnitVoice(byte status, int unit) {
+  int voice = (status & 0x1F) - unit * polycount;
+  return voice >= 0 && voice < polycount ? voice : -1;
+}
+
+// Chain voice playing the note, -1 for none
+int getChainVoiceNo(int note) {
+  int chainVoiceCount = chainUnits * polycount;
+  for (int i = 0; i < chainVoiceCount; i++) {
+    if (chainVoices[i].note == note) return i;
+  }
+  return -1;
+}
+
+// The patch's allocation strategy picks from the whole chain
+void chainNoteOn(byte note, byte velocity) {
+  int voice = allocFrom(chainVoices, chainUnits * polycount, note);
+  chainVoices[voice].note = note;
+  chainVoices[voice].velocity = velocity;
+  chainVoices[voice].timeOn = millis();
+  if (voice < polycount) {
+    voiceNoteOn(voice, note, velocity);
+  } else {
+    chainSend(CHAIN_MSG_ON, voice, note, velocity);
+  }
+}
+
+void chainNoteOff(byte note) {
+  int voice = getChainVoiceNo(note);
+  if (voice == -1) return;
+  chainVoices[voice].note = -1;
+  if (voice < polycount) {
+    voiceNoteOff(voice);
+  } else {
+    chainSend(CHAIN_MSG_OFF, voice, note, 0);
+  }
+}
+
+void chainAllNotesOff() {
+  if (chainMode != CHAIN_LEADER) return;
+  for (int i = 0; i < CHAIN_MAX_UNITS * NO_OF_VOICES; i++) {
+    chainVoices[i].note = -1;
+  }
+  if (chainUnits > 1) chainSend(CHAIN_MSG_ALLOFF, 0, 0, 0);
+}
+
+void chainApply(byte status, byte note, byte velocity) {
+  byte type = (status >> 5) & 0x03;
+  int voice = chainUnitVoice(status, chainMode - CHAIN_LEADER);
+
+  if (type == CHAIN_MSG_ALLOFF) {
+    allNotesOff();
+    return;
+  }
+  if (voice < 0) return;  // Belongs to another unit
+
+  if (type == CHAIN_MSG_ON) {
+    voiceNoteOn(voice, note, velocity);
+  } else if (voices[voice].note == note) {
+    voiceNoteOff(voice);
+  }
+}
+
+void chainRead() {
+  if (chainMode < CHAIN_FOLLOWER1) return;
+  while (CHAIN_SERIAL.available()) {
+    byte b = CHAIN_SERIAL.read();
+    CHAIN_SERIAL.write(b);  // Pass straight on to the next unit
+    if (chainDecode(chainIn, b)) {
+      chainApply(chainIn.status, chainIn.data[0], chainIn.data[1]);
+      chainIn.status = 0;
+    }
+  }
+}
+
+// Pipes one message from the leader through every follower's decoder, a
+// truncated one when cut, and updates each follower's notes as chainApply would
+uint32_t chainPipe(ChainParser *parsers, int notes[][NO_OF_VOICES], const byte *message, int length) {
+  uint32_t start = PROFILE_NOW();
+  for (int i = 0; i < length; i++) {
+    for (int unit = 1; unit < chainUnits; unit++) {
+      ChainParser &p = parsers[unit];
+      if (!chainDecode(p, message[i])) continue;
+      p.status = 0;
+      byte type = (message[0] >> 5) & 0x03;
+      int voice = chainUnitVoice(message[0], unit);
+      if (type == CHAIN_MSG_ALLOFF) {
+        for (int v = 0; v < NO_OF_VOICES; v++) notes[unit][v] = -1;
+      } else if (voice >= 0 && type == CHAIN_MSG_ON) {
+        notes[unit][voice] = p.data[0];
+      } else if (voice >= 0 && notes[unit][voice] == p.data[0]) {
+        notes[unit][voice] = -1;
+      }
+    }
+  }
+  return PROFILE_NOW() - start;
+}
+
+void chainTest(int events) {
+  VoiceAndNote saved[CHAIN_MAX_UNITS * NO_OF_VOICES];
+  memcpy(saved, chainVoices, sizeof(saved));
+  int savedUnits = chainUnits;
+  chainUnits = CHAIN_MAX_UNITS;
+  int chainVoiceCount = chainUnits * polycount;
+  ChainParser parsers[CHAIN_MAX_UNITS] = {};
+  int notes[CHAIN_MAX_UNITS][NO_OF_VOICES];
+  for (int unit = 0; unit < CHAIN_MAX_UNITS; unit++) {
+    for (int v = 0; v < NO_OF_VOICES; v++) notes[unit][v] = -1;
+  }
+  for (int i = 0; i < CHAIN_MAX_UNITS * NO_OF_VOICES; i++) chainVoices[i] = { -1, -1, 0 };
+  uint32_t random = 12345;
+  long clock = 1;
+  uint32_t ticks = 0, messages = 0, cut = 0, failures = 0;
+  for (int n = 0; n < events; n++) {
+    random = random * 1664525 + 1013904223;
+    byte message[3];
+    int held = 0;
+    for (int i = 0; i < chainVoiceCount; i++) held += chainVoices[i].note != -1;
+    if ((random >> 24) < 4) {  // All notes off
+      for (int i = 0; i < chainVoiceCount; i++) chainVoices[i].note = -1;
+      chainEncode(message, CHAIN_MSG_ALLOFF, 0, 0, 0);
+    } else if (held && (random >> 24) < 112) {  // Note off for a sounding voice
+      int voice = (random >> 8) % chainVoiceCount;
+      while (chainVoices[voice].note == -1) voice = (voice + 1) % chainVoiceCount;
+      byte note = chainVoices[voice].note;
+      voice = getChainVoiceNo(note);
+      chainVoices[voice].note = -1;
+      if (voice < polycount) continue;  // The leader's own voice
+      chainEncode(message, CHAIN_MSG_OFF, voice, note, 0);
+    } else {
+      byte note = 36 + (random >> 16) % 49;
+      int voice = allocFrom(chainVoices, chainVoiceCount, note);
+      chainVoices[voice] = { note, 100, clock++ };
+      if (voice < polycount) continue;
+      chainEncode(message, CHAIN_MSG_ON, voice, note, 100);
+    }
+    if ((random & 0xFF) < 8) {  // A message cut short, the next status byte must resync
+      ticks += chainPipe(parsers, notes, message, 1 + (random >> 8) % 2);
+      cut++;
+    }
+    ticks += chainPipe(parsers, notes, message, 3);
+    messages++;
+    for (int unit = 1; unit < chainUnits; unit++) {
+      for (int v = 0; v < polycount; v++) {
+        if (notes[unit][v] != chainVoices[unit * polycount + v].note) {
+          failures++;
+          unit = chainUnits;
+          break;
+        }
+      }
+    }
+  }
+  Serial.print("chain messages ");
+  Serial.print(messages);
+  Serial.print(" cut ");
+  Serial.print(cut);
+  Serial.print(" us each ");
+  Serial.print(messages ? (float)ticks / PROFILE_TICKS_PER_US / messages : 0, 3);
+  Serial.print(" failures ");
+  Serial.println(failures);
+  memcpy(chainVoices, saved, sizeof(saved));
+  chainUnits = savedUnits;
+}
+
+void chainCommand(const char *args) {
+  if (strncmp(args, "test", 4) == 0) {
+    if (polycount == 0) {
+      Serial.println("chain test needs a poly count");
+      return;
+    }
+    int events = atoi(args + 4);
+    chainTest(events > 0 ? min(events, CHAIN_TEST_EVENTS_MAX) : CHAIN_TEST_EVENTS);
+    return;
+  }
+  const char *modes[] = { "off", "leader", "follower 1", "follower 2" };
+  Serial.print("chain ");
+  Serial.print(modes[constrain(chainMode, CHAIN_OFF, CHAIN_FOLLOWER2)]);
+  Serial.print(" units ");
+  Serial.println(chainUnits);
+}
+
+void setupChain() {
+  CHAIN_SERIAL.begin(CHAIN_BAUD);
+  for (int i = 0; i < CHAIN_MAX_UNITS * NO_OF_VOICES; i++) {
+    chainVoices[i] = { -1, -1, 0 };
+  }
+  consoleAppend("chain", "voice chain mode, chain test [events] checks the protocol", chainCommand);
+}